@@ -0,0 +1,44 @@
+/* -=- Includes -=- */
+#include <llama.h>
+#include <ir.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+
+// Instruction dispatch throughput: a function made of 1000 x (PUSHINT, PUSHINT, ADD, POP) is
+// called over and over, so nearly all the time goes to fetching and jumping between handlers
+int main(int argc, const char * argv[]) {
+    const int ROUNDS = 1000;
+    int calls = argc > 1 ? atoi(argv[1]) : 2000;
+
+    llama::VM     * vm  = new llama::VM();
+    llama::Module * mod = vm->get_module();
+
+    llama::IRBuilder ir;
+    ir.set_module(mod);
+    for (int i = 0; i < ROUNDS; ++i) {
+        ir._pushint(1);
+        ir._pushint(2);
+        ir._add();
+        ir._pop();
+    }
+    ir._returnv();
+
+    llama::FunctionEntry func;
+    size_t idx = mod->get_functions()->add(func);
+    ir.build(mod->get_functions()->at(idx)->get_data());
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; ++i) {
+        vm->push(llama::Value(idx, llama::Type::Function));
+        vm->call(0, true);
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double ops = (double)(ROUNDS) * 4 * calls;
+    fprintf(stderr, "%.0f ops in %.3fs, %.2f Mops/s\n", ops, secs, ops / secs / 1e6);
+
+    delete vm;
+    return 0;
+}
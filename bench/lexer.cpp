@@ -0,0 +1,134 @@
+/* -=- Includes -=- */
+#include <lexer.h>
+#include <error.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// Source generators, the first argument picks one of them or names a file to read instead. The
+// random ones always give the same text for a given number of lines
+static unsigned next_rand(unsigned & seed) {
+    seed = seed * 1103515245u + 12345u;
+    return (seed >> 16) & 0x7fff;
+}
+
+static void rand_text(std::string & src, unsigned & seed, const char * chars, size_t min, size_t max) {
+    size_t count = strlen(chars);
+    size_t size  = min + next_rand(seed) % (max - min + 1);
+    for (size_t i = 0; i < size; ++i) src += chars[next_rand(seed) % count];
+}
+
+static std::string gen_calls(size_t lines) {
+    // Two nested calls per line, each one bracketed by the lexer
+    std::string src;
+    for (size_t i = 0; i < lines; ++i) src += "var x = f(f(n, 2), 3);\n";
+    return src;
+}
+
+static std::string gen_comments(size_t lines) {
+    // Line comments, with a block comment spanning a few lines every fourth one. Stars and slashes
+    // show up inside both, never as a star right before a slash in the block ones
+    std::string src;
+    unsigned    seed = 1;
+    for (size_t i = 0; i < lines; ++i) {
+        if (i % 4 == 0) {
+            src += "/* ";
+            for (int j = 0; j < 3; ++j) {
+                rand_text(src, seed, "abcdefghijklmn   *", 10, 60);
+                src += "\n";
+            }
+            src += " */\n";
+        } else {
+            src += "// ";
+            rand_text(src, seed, "abcdefghijklmn   */", 10, 90);
+            src += "\n";
+        }
+    }
+    return src;
+}
+
+static std::string gen_labels(size_t lines) {
+    // Deeply indented labels, mostly whitespace
+    std::string src;
+    for (size_t i = 0; i < lines; ++i) {
+        src += std::string(4 * (i % 12), ' ');
+        src += "label_" + std::to_string(i) + "\n";
+    }
+    return src;
+}
+
+static std::string gen_strings(size_t lines) {
+    // Declarations of long string literals, quoted with " and ` in turns
+    std::string src;
+    unsigned    seed = 1;
+    for (size_t i = 0; i < lines; ++i) {
+        char quote = i % 2 == 0 ? '"' : '`';
+
+        src += "var s" + std::to_string(i) + " = ";
+        src += quote;
+        rand_text(src, seed, "abcdefghijklmn   \\'", 20, 120);
+        src += quote;
+        src += "\n";
+    }
+    return src;
+}
+
+// Lexer throughput, best of 7 runs over a source held in memory. Trees from before the streaming
+// lexer (no LLAMA_LEX_CHUNK) read everything in parse(), later ones are pulled token by token
+int main(int argc, const char * argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <calls | comments | labels | strings | file> [lines]\n", argv[0]);
+        return 1;
+    }
+
+    size_t      lines = argc > 2 ? (size_t)(atol(argv[2])) : 100000;
+    std::string src;
+
+    if (strcmp(argv[1], "calls") == 0) {
+        src = gen_calls(lines);
+    } else if (strcmp(argv[1], "comments") == 0) {
+        src = gen_comments(lines);
+    } else if (strcmp(argv[1], "labels") == 0) {
+        src = gen_labels(lines);
+    } else if (strcmp(argv[1], "strings") == 0) {
+        src = gen_strings(lines);
+    } else {
+        std::ifstream file(argv[1]);
+        if (!file) {
+            fprintf(stderr, "can't open %s\n", argv[1]);
+            return 1;
+        }
+
+        std::stringstream stream;
+        stream << file.rdbuf();
+        src = stream.str();
+    }
+
+    double best   = 0.0;
+    size_t tokens = 0;
+    for (int i = 0; i < 7; ++i) {
+        llama::Logger log;
+        llama::Lexer  lex;
+
+        auto start = std::chrono::steady_clock::now();
+#ifdef LLAMA_LEX_CHUNK
+        lex.parse(&log, src);
+        for (tokens = 0; lex.has(tokens); ++tokens) lex.release(tokens + 1);
+#else
+        lex.parse(&log, src);
+        tokens = lex.size();
+#endif
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (i == 0 || secs < best) best = secs;
+    }
+
+    fprintf(stderr, "%s: %zu bytes, %zu tokens, %.1f ms, %.0f MB/s\n",
+            argv[1], src.size(), tokens, best * 1000, src.size() / best / 1e6);
+    return 0;
+}
@@ -0,0 +1,53 @@
+#!/bin/sh
+# Builds the benchmark bench/<name>.cpp with optimizations and runs it on the working tree. When
+# BASE names a revision, the same driver is also built and run on that revision first, for a
+# before/after comparison. PATCH, when given, is applied to that revision first (old trees can lack
+# what a driver needs). CXXFLAGS is passed to both builds
+#
+#   bench/run.sh dispatch
+#   BASE=HEAD~1 bench/run.sh dispatch 5000
+#   BASE=a7848ab PATCH=bench/patches/get_module.patch bench/run.sh dispatch
+#
+# Results go to stderr, so whatever a tree prints on stdout can be thrown away with >/dev/null
+set -e
+
+if [ $# -lt 1 ]; then
+    echo "usage: [BASE=<rev>] [PATCH=<file>] [CXXFLAGS=...] $0 <name> [args...]" >&2
+    exit 1
+fi
+
+name=$1
+shift
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+driver=$root/bench/$name.cpp
+out=$(mktemp -d)
+
+if [ ! -f "$driver" ]; then
+    echo "no benchmark named $name in $root/bench" >&2
+    exit 1
+fi
+
+cleanup() {
+    if [ -n "$BASE" ]; then git -C "$root" worktree remove --force "$out/base" 2>/dev/null || true; fi
+    rm -rf "$out"
+}
+trap cleanup EXIT
+
+# build <tree> <binary>
+build() {
+    (cd "$1" && g++ -std=c++11 -O2 -pthread $CXXFLAGS -Iinclude "$driver" \
+        $(ls src/*.cpp src/*/*.cpp 2>/dev/null | grep -v '^src/main.cpp$') -o "$2")
+}
+
+if [ -n "$BASE" ]; then
+    git -C "$root" worktree add --detach --quiet "$out/base" "$BASE"
+    if [ -n "$PATCH" ]; then git -C "$out/base" apply "$(cd "$(dirname "$PATCH")" && pwd)/$(basename "$PATCH")"; fi
+    build "$out/base" "$out/before"
+    echo "[ $name, $BASE ]" >&2
+    "$out/before" "$@"
+fi
+
+build "$root" "$out/after"
+echo "[ $name, working tree ]" >&2
+"$out/after" "$@"
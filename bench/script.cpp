@@ -0,0 +1,33 @@
+/* -=- Includes -=- */
+#include <llama.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+
+// Whole runs of a script (bench/inputs/loop.ls by default, or the first argument), lexing and
+// compiling included. Every run gets a fresh VM, the best of 5 (or the second argument) is kept
+int main(int argc, const char * argv[]) {
+    const char * path = argc > 1 ? argv[1] : "bench/inputs/loop.ls";
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+
+    double best = 0.0;
+    for (int i = 0; i < runs; ++i) {
+        llama::VM * vm = new llama::VM();
+
+        auto start = std::chrono::steady_clock::now();
+        llama::Status status = vm->do_file(path);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        delete vm;
+
+        if (status != llama::Ok) {
+            fprintf(stderr, "%s failed to run\n", path);
+            return 1;
+        }
+        if (i == 0 || secs < best) best = secs;
+    }
+
+    fprintf(stderr, "%s: best of %d runs, %.1f ms\n", path, runs, best * 1000);
+    return 0;
+}
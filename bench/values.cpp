@@ -0,0 +1,30 @@
+/* -=- Includes -=- */
+#include <llama.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+
+// Memory bandwidth of values: sums a large array of ints (4M by default, or the first argument)
+// 20 times over. It stands in for lists, which the VM can't build yet, and mostly shows the cost
+// of sizeof(Value), build with -DLLAMA_NAN_BOXING to compare both layouts
+int main(int argc, const char * argv[]) {
+    const int PASSES = 20;
+    int count = argc > 1 ? atoi(argv[1]) : 4000000;
+
+    std::vector<llama::Value> values;
+    values.reserve(count);
+    for (int i = 0; i < count; ++i) values.push_back(llama::Value(i));
+
+    auto start = std::chrono::steady_clock::now();
+    long long sum = 0;
+    for (int i = 0; i < PASSES; ++i) {
+        for (auto & value : values) sum += value.get_int();
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fprintf(stderr, "sizeof(Value) = %zu, %.0f M elements/s (sum %lld)\n",
+            sizeof(llama::Value), (double)(count) * PASSES / secs / 1e6, sum);
+    return 0;
+}
@@ -0,0 +1,72 @@
+#ifndef LLAMA_ALLOCATOR_H
+#define LLAMA_ALLOCATOR_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#define LLAMA_POOL_CLASSES   12          // Number of size classes of the pool allocator
+#define LLAMA_POOL_MAX_SIZE  512         // Biggest block served from a size class, in bytes
+#define LLAMA_POOL_SLAB_SIZE (16 * 1024) // Memory requested from the system at once, in bytes
+
+namespace llama {
+    typedef void * (* AllocFn)(void * user, size_t size);            // Custom function for allocating
+    typedef void   (* FreeFn)(void * user, void * ptr, size_t size); // Custom function for freeing
+
+    struct AllocStats {
+        size_t allocations; // Blocks handed out so far
+        size_t frees;       // Blocks given back so far
+        size_t in_use;      // Bytes requested by live blocks
+        size_t reserved;    // Bytes held from the system to serve them
+    };
+
+    // Backing memory of the VM heap. Small blocks come from segregated free lists carved out of
+    // fixed size slabs, one list per size class, bigger ones fall back to malloc. Slabs are only
+    // released with the allocator, freed blocks are reused by later allocations of their class.
+    // Embedders can replace all of this with their own functions (see VMConfig::alloc), or hand
+    // out a fixed region that every block is carved from, in which case malloc is never called (big
+    // blocks given back to a region are split and merged with their free neighbours as needed)
+    class Allocator {
+    public:
+        Allocator(AllocFn m_alloc_fn = nullptr, FreeFn m_free_fn = nullptr, void * m_user = nullptr);
+        Allocator(void * region, size_t size);
+        ~Allocator();
+
+        void * alloc(size_t size);
+        void   release(void * ptr, size_t size);
+
+        AllocStats get_stats();
+        double     get_fragmentation();
+
+        std::string dump();
+    private:
+        struct FreeBlock {
+            FreeBlock * next;
+            size_t      size; // Only set for big region blocks, their header included
+        };
+
+        size_t class_of(size_t size);
+        void * carve(size_t size);
+        void * alloc_large(size_t size);
+        void   release_large(FreeBlock * block);
+
+        AllocFn alloc_fn;
+        FreeFn  free_fn;
+        void *  user;
+
+        FreeBlock * free_lists[LLAMA_POOL_CLASSES];
+
+        FreeBlock * large_free; // Big blocks given back to the region, sorted by address
+
+        std::vector<void *> slabs;
+
+        char * region_start;
+        char * region_cur;
+        char * region_end;
+
+        AllocStats stats;
+    };
+}
+
+#endif
@@ -4,6 +4,11 @@
 #include <lexer.h>
 #include <ir.h>
 #include <module.h>
+#include <arena.h>
+#include <ast.h>
+#include <resolver.h>
+#include <folder.h>
+#include <codegen.h>
 
 #include <cstdint>
 #include <cstddef>
@@ -12,6 +17,9 @@
 #include <stack>
 
 namespace llama {
+    // Turns tokens into a syntax tree one top level statement at a time, then hands it over to the
+    // resolver, the constant folder and the code generator. The tree lives in an arena that is
+    // dropped as a whole once its statement was emitted
     class Analyser {
     public:
         Analyser();
@@ -21,27 +29,55 @@ namespace llama {
         
         void dump();
     private:
-        size_t parse_statement(size_t pos);
-        size_t parse_scope(size_t pos, bool initialize = true);
-        size_t parse_if(size_t pos);
-        size_t parse_while(size_t pos);
-        size_t parse_for(size_t pos);
-        size_t parse_loop(size_t pos);
-        size_t parse_fn(size_t pos, bool expr = false);
+        size_t parse_module();
+        size_t parse_statement(size_t pos, Node *& node);
+        size_t parse_scope(size_t pos, BlockNode *& node, bool initialize = true);
+        size_t parse_if(size_t pos, Node *& node);
+        size_t parse_while(size_t pos, Node *& node);
+        size_t parse_for(size_t pos, Node *& node);
+        size_t parse_loop(size_t pos, Node *& node);
+        size_t parse_fn(size_t pos, Node *& node);
         // size_t parse_class(size_t pos);
         // size_t parse_class_field(size_t pos, ClassDB & c);
-        size_t parse_single(size_t pos);
-        size_t parse_double(size_t pos);
-        size_t parse_declaration(size_t pos, bool can_assign = true, Token::Type end = Token::Type::End);
-        size_t parse_expr(size_t pos, bool can_assign = true, bool is_decl = false, Token::Type end = Token::Type::End);
+        size_t parse_single(size_t pos, Node *& node);
+        size_t parse_double(size_t pos, Node *& node);
+        size_t parse_declaration(size_t pos, Node *& node, bool can_assign = true, Token::Type end = Token::Type::End);
+        size_t parse_expr(size_t pos, Node *& node, bool can_assign = true, bool is_decl = false, Token::Type end = Token::Type::End);
+
+        // Expressions are parsed by precedence climbing, the left operand goes in and out of node
+        size_t parse_precedence(size_t pos, Node *& node, int min_prec, bool can_assign = false);
+        size_t parse_prefix(size_t pos, Node *& node, bool can_assign);
+        size_t parse_infix(size_t pos, Node *& node, Token op);
+        size_t parse_call(size_t pos, Node *& node);
+        size_t parse_assign(size_t pos, Node *& node, size_t equal, bool can_assign);
+        size_t unexpected(Token token);
         
         Token seek_token(size_t pos);
 
+        template <typename T> T * make_node(Node::Kind kind, Token at);
+        NodeList make_list(size_t base);
+
+        Arena               arena;
+        std::vector<Node *> pending; // Children of the lists being parsed, moved to the arena once complete
+
+        Resolver  resolver;
+        Folder    folder;
+        CodeGen   codegen;
+
         Module    * mod;
         Lexer     * lex;
         Logger    * log;
         IRBuilder * ir;
     };
+
+    template <typename T>
+    inline T * Analyser::make_node(Node::Kind kind, Token at) {
+        T * node = arena.make<T>();
+        node->kind   = kind;
+        node->start  = at.start;
+        node->length = at.length;
+        return node;
+    }
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef LLAMA_ARENA_H
+#define LLAMA_ARENA_H
+
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+#define LLAMA_ARENA_CHUNK (16 * 1024) // Memory requested from the system at once by arenas, in bytes
+
+namespace llama {
+    // Bump allocator for data that all dies at the same time, like the syntax tree of a statement.
+    // Blocks are carved one after the other out of chunks and never freed on their own, reset()
+    // drops everything at once (keeping a chunk around for the next round) and nothing allocated
+    // here ever gets its destructor called
+    class Arena {
+    public:
+        Arena(size_t m_chunk_size = LLAMA_ARENA_CHUNK);
+        ~Arena();
+
+        void * alloc(size_t size);
+        char * copy(const char * str, size_t length);
+        void   reset();
+
+        template <typename T> T * make();
+        template <typename T> T * make_array(size_t count);
+
+        size_t get_used();
+        size_t get_reserved();
+    private:
+        struct Chunk {
+            Chunk * next;
+            size_t  size;
+        };
+
+        static constexpr size_t ALIGN = alignof(std::max_align_t);
+        static constexpr size_t HEADER = (sizeof(Chunk) + ALIGN - 1) & ~(ALIGN - 1);
+
+        void * grow(size_t size);
+
+        Chunk * chunks; // Newest first, the one being carved is always the first
+        char *  cur;
+        char *  end;
+
+        size_t chunk_size;
+        size_t used;
+        size_t reserved;
+    };
+
+    inline void * Arena::alloc(size_t size) {
+        size = (size + ALIGN - 1) & ~(ALIGN - 1);
+        if ((size_t)(end - cur) < size) return grow(size);
+
+        void * ptr = cur;
+        cur  += size;
+        used += size;
+
+        return ptr;
+    }
+
+    template <typename T>
+    inline T * Arena::make() {
+        static_assert(std::is_trivially_destructible<T>::value, "arenas never run destructors");
+        return new (alloc(sizeof(T))) T();
+    }
+
+    template <typename T>
+    inline T * Arena::make_array(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "arenas never run destructors");
+        if (count == 0) return nullptr;
+
+        T * arr = (T *)(alloc(sizeof(T) * count));
+        for (size_t i = 0; i < count; ++i) new (&arr[i]) T();
+
+        return arr;
+    }
+}
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef LLAMA_AST_H
+#define LLAMA_AST_H
+
+#include <lexer.h>
+#include <error.h>
+#include <module/symbol_pool.h>
+
+#include <cstdint>
+#include <cstddef>
+
+namespace llama {
+    // Syntax tree the analyser builds out of each statement, before anything gets emitted. Nodes
+    // are plain structs living in an Arena, so they only hold trivially destructible things: names
+    // are symbols, strings are copied into the arena, and the only tokens they remember are where
+    // they get reported at
+    struct Node {
+        enum class Kind : unsigned char {
+            // Expressions
+            Null,
+            True,
+            False,
+            Integer,
+            Decimal,
+            String,
+            Name,
+            Property,
+            Unary,
+            Binary,
+            Call,
+            Assign,
+            SetProperty,
+
+            // Statements
+            ExprStmt,
+            Decl,
+            Block,
+            If,
+            While,
+            Loop,
+            Fn,
+            Repeat,
+            Break,
+            Return,
+        };
+
+        Kind     kind;
+        uint32_t start;  // Source slice errors about the node point at (UINT32_MAX for none)
+        uint32_t length;
+
+        LogSnippet snippet() const {
+            if (start == UINT32_MAX) return LogSnippet();
+            return LogSnippet(start, length);
+        }
+
+        template <typename T> T * as() {
+            return static_cast<T *>(this);
+        }
+    };
+
+    struct NodeList {
+        Node ** items;
+        size_t  size;
+    };
+
+    /* -=- Expressions -=- */
+    struct IntegerNode : Node {
+        int value;
+    };
+
+    struct DecimalNode : Node {
+        double value;
+    };
+
+    struct StringNode : Node {
+        const char * str; // Without its quotes
+    };
+
+    struct NameNode : Node {
+        Symbol name;
+        size_t slot; // Local slot, ERROR_IDX for globals (set by the resolver)
+    };
+
+    struct PropertyNode : Node {
+        Node * object;
+        Symbol name;
+    };
+
+    struct UnaryNode : Node {
+        Token::Type op; // Plus, Minus or Not
+        Node *      operand;
+    };
+
+    struct BinaryNode : Node {
+        Token::Type op;
+        Node *      lhs;
+        Node *      rhs;
+    };
+
+    struct CallNode : Node {
+        Node *   callee;
+        NodeList args;
+    };
+
+    struct AssignNode : Node {
+        Symbol name;
+        size_t slot; // As for NameNode
+        Node * value;
+    };
+
+    struct SetPropertyNode : Node {
+        Symbol   root; // Always a global
+        Symbol * path;
+        size_t   path_size;
+        Node *   value;
+    };
+
+    /* -=- Statements -=- */
+    struct ExprStmtNode : Node {
+        Node * expr;
+    };
+
+    struct DeclNode : Node {
+        bool   local;
+        Symbol name;
+        size_t slot;  // Slot the value is stored into, ERROR_IDX for globals (set by the resolver)
+        Node * value; // nullptr when there's none
+    };
+
+    struct BlockNode : Node {
+        NodeList body;
+        bool     block; // Opens a block in the IR, not only a scope for the locals
+    };
+
+    struct IfNode : Node {
+        Node *      cond;
+        BlockNode * then;
+        BlockNode * otherwise; // nullptr without an else
+    };
+
+    struct WhileNode : Node {
+        Node *      cond;
+        BlockNode * body;
+    };
+
+    struct LoopNode : Node {
+        BlockNode * body;
+    };
+
+    struct FnNode : Node {
+        struct Argument {
+            Symbol       symbol;
+            const char * type; // nullptr when there's no annotation
+        };
+
+        Symbol      name; // ERROR_IDX_BIN for anonymous functions
+        Argument *  args;
+        size_t      argc;
+        BlockNode * body;
+        int         line;
+        size_t      locals; // Frame size, arguments included (set by the resolver)
+    };
+
+    struct ReturnNode : Node {
+        Node * value; // nullptr for a bare return
+    };
+}
+
+#endif
@@ -40,16 +40,20 @@ Follows a C-like syntax for what it does
 #define LLAMA_OP_PUSHDYN    0x18 // Pushes a dynamic value to the stack
 #define LLAMA_OP_PUSHFUNC   0x1e // Pushes a function to the stack
 
-#define LLAMA_OP_SETGLOBAL   0x20
-#define LLAMA_OP_GETGLOBAL   0x21
-#define LLAMA_OP_SETPROPERTY 0x22
-#define LLAMA_OP_GETPROPERTY 0x23
-#define LLAMA_OP_SETINDEX    0x24
-#define LLAMA_OP_GETINDEX    0x25
-#define LLAMA_OP_NEWGLOBAL   0x26
-#define LLAMA_OP_NEWLOCAL    0x27
-#define LLAMA_OP_POP         0x2e
-#define LLAMA_OP_POPN        0x2f
+#define LLAMA_OP_SETGLOBAL        0x20
+#define LLAMA_OP_GETGLOBAL        0x21
+#define LLAMA_OP_SETPROPERTY      0x22
+#define LLAMA_OP_GETPROPERTY      0x23
+#define LLAMA_OP_SETINDEX         0x24
+#define LLAMA_OP_GETINDEX         0x25
+#define LLAMA_OP_NEWGLOBAL        0x26 // Declares the global slot [t+0]
+#define LLAMA_OP_NEWLOCAL         0x27 // Clears the local slot [t+0] of the current frame
+#define LLAMA_OP_GETLOCAL         0x28 // Pushes the local slot [t+0] of the current frame
+#define LLAMA_OP_SETLOCAL         0x29 // Sets the local slot [t+0] of the current frame to [s-1]
+#define LLAMA_OP_GETGLOBAL_SLOT   0x2a // Pushes the global slot [t+0]
+#define LLAMA_OP_SETGLOBAL_SLOT   0x2b // Sets the global slot [t+0] to [s-1]
+#define LLAMA_OP_POP              0x2e
+#define LLAMA_OP_POPN             0x2f
 
 #define LLAMA_OP_ADD     0x30 // Pushes the addition of [s-2] and [s-1]
 #define LLAMA_OP_SUB     0x31 // Pushes the subtraction of [s-2] by [s-1]
@@ -105,6 +109,7 @@ Follows a C-like syntax for what it does
 #define LLAMA_OPFLAG_ISBLOCK  (1 << 3) // Creates a new scope
 #define LLAMA_OPFLAG_ISEND    (1 << 4) // Pops a scope
 #define LLAMA_OPFLAG_ISTRAP   (1 << 5) // Creates a trap
+#define LLAMA_OPFLAG_SLOTARG  (1 << 6) // Uses global slot indexes as arguments
 
 #define GET_OP(__name)   (LLAMA_OP_ ## __name)
 #define GET_FLAG(__name) (LLAMA_OPFLAG_ ## __name)
@@ -0,0 +1,35 @@
+#ifndef LLAMA_CODEGEN_H
+#define LLAMA_CODEGEN_H
+
+#include <ast.h>
+#include <ir.h>
+#include <module.h>
+#include <error.h>
+
+#include <cstdint>
+#include <cstddef>
+
+namespace llama {
+    // Emits the IR of resolved syntax trees, functions are built and added to the module as they
+    // come, everything else goes to the builder being fed
+    class CodeGen {
+    public:
+        CodeGen();
+
+        void   setup(Module * m_mod, Logger * m_log, IRBuilder * m_ir);
+        Status emit(Node * node);
+    private:
+        Status emit_expr(Node * node);
+        Status emit_block(BlockNode * node);
+        Status emit_fn(FnNode * node);
+
+        void emit_get(Symbol name, size_t slot);
+        void emit_set(Symbol name, size_t slot);
+
+        Module    * mod;
+        Logger    * log;
+        IRBuilder * ir;
+    };
+}
+
+#endif
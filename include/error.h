@@ -2,43 +2,82 @@
 #define LLAMA_ERROR_H
 
 #include <climits>
+#include <cstdarg>
+#include <cstdint>
+#include <cstddef>
 #include <string>
+#include <vector>
 
 #define ERROR_IDX     (SIZE_MAX)
 #define ERROR_IDX_BIN (UINT32_MAX)
 
-#define LOG(type, ...) {\
+// Log levels, in the same order as Logger::Type (errors are always compiled in)
+#define LLAMA_LOG_INFO    0
+#define LLAMA_LOG_WARNING 1
+#define LLAMA_LOG_ERROR   2
+
+// Least severe level compiled in, the calls below it vanish along with their arguments
+#ifndef LLAMA_LOG_LEVEL
+#ifdef LLAMA_DEBUG
+#define LLAMA_LOG_LEVEL LLAMA_LOG_INFO
+#else
+#define LLAMA_LOG_LEVEL LLAMA_LOG_WARNING
+#endif
+#endif
+
+#define LLAMA_LOG_COMPILED(level) (LLAMA_LOG_LEVEL <= (level))
+
+#define LLAMA_LOG_RING   32  // Warnings and errors kept by a logger
+#define LLAMA_LOG_ARGS   256 // Bytes of arguments kept by each of them
+#define LLAMA_LOG_SOURCE 128 // Bytes of the source name kept by each of them
+#define LLAMA_LOG_LINE   512 // Longest line printed
+
+#define LOG(type, code, ...) {\
             log->set_debug(__FILE__, __LINE__, __PRETTY_FUNCTION__);\
+            log->set_code(code);\
             log->log((type), __VA_ARGS__);\
         }
 
+#if LLAMA_LOG_COMPILED(LLAMA_LOG_INFO)
 #define INFO(...) {\
-            log->set_debug(nullptr, 0, nullptr);\
-            log->log(llama::Logger::Info, __VA_ARGS__);\
+            if (log->enabled(llama::Logger::Info)) {\
+                log->set_debug(nullptr, 0, nullptr);\
+                log->set_code(llama::ErrorCode::None);\
+                log->log(llama::Logger::Info, __VA_ARGS__);\
+            }\
         }
+#else
+#define INFO(...) {}
+#endif
 
+#if LLAMA_LOG_COMPILED(LLAMA_LOG_WARNING)
 #define WARN(...) {\
-            LOG(llama::Logger::Warning, __VA_ARGS__);\
+            if (log->enabled(llama::Logger::Warning)) LOG(llama::Logger::Warning, llama::ErrorCode::None, __VA_ARGS__);\
         }
 
 #define SYNTAXWARN(...) {\
-            LOG(llama::Logger::Warning, __VA_ARGS__);\
+            if (log->enabled(llama::Logger::Warning)) LOG(llama::Logger::Warning, llama::ErrorCode::None, __VA_ARGS__);\
         }
+#else
+#define WARN(...)       {}
+#define SYNTAXWARN(...) {}
+#endif
 
-#define RUNTIMEERROR(...) {\
-            LOG(llama::Logger::RuntimeError, __VA_ARGS__);\
+// Errors take the name of their llama::ErrorCode first, as in SYNTAXERROR(UnexpectedToken, ...)
+#define RUNTIMEERROR(__code, ...) {\
+            LOG(llama::Logger::RuntimeError, llama::ErrorCode::__code, __VA_ARGS__);\
         }
 
-#define SYNTAXERROR(...) {\
-            LOG(llama::Logger::SyntaxError, __VA_ARGS__);\
+#define SYNTAXERROR(__code, ...) {\
+            LOG(llama::Logger::SyntaxError, llama::ErrorCode::__code, __VA_ARGS__);\
         }
 
-#define TYPEERROR(...) {\
-            LOG(llama::Logger::TypeError, __VA_ARGS__);\
+#define TYPEERROR(__code, ...) {\
+            LOG(llama::Logger::TypeError, llama::ErrorCode::__code, __VA_ARGS__);\
         }
 
-#define PANIC(...) {\
-            LOG(llama::Logger::Panic, __VA_ARGS__);\
+#define PANIC(__code, ...) {\
+            LOG(llama::Logger::Panic, llama::ErrorCode::__code, __VA_ARGS__);\
         }
 
 namespace llama {
@@ -46,19 +85,72 @@ namespace llama {
         Ok, 
         Failure, 
     };
+
+    // What an error was about, so hosts can tell them apart without parsing their messages
+    enum class ErrorCode : unsigned short {
+        None,     // Infos and warnings
+        Internal, // A bug of the compiler or the runtime itself
+
+        // Reading the source
+        SourceTooBig, 
+        UnexpectedCharacter, 
+        UnterminatedComment, 
+        UnterminatedString, 
+        MalformedNumber, 
+        NumberOutOfRange, 
+        UnknownOperator, 
+        UnexpectedToken, 
+        UnmatchedToken, 
+
+        // Compiling
+        ExpectedName, 
+        ExpectedExpression, 
+        MissingEnd, 
+        InvalidAssignment, 
+        AlreadyDeclared, 
+
+        // Running
+        FileError, 
+        MalformedBytecode, 
+        NotDeclared, 
+        NotCallable, 
+        TypeMismatch, 
+        StackOverflow, 
+        InvalidStack, 
+        OutOfMemory, 
+        TooManyGlobals, 
+        DivisionByZero, 
+        IntegerOverflow, 
+    };
     
+    // Where a log refers to in the source
     class LogSnippet {
     public:
         LogSnippet();
-        LogSnippet(std::string str, size_t pos);
+        LogSnippet(size_t pos, size_t len = 0);
         ~LogSnippet();
 
-        size_t start;
-        size_t end;
-        size_t line;
-        size_t collumn;
+        size_t start;  // Byte offset (ERROR_IDX when there's no snippet)
+        size_t length; // Length in bytes
     };
 
+    // Offsets of every line start of a source, built as it gets read and searched on demand
+    class LineIndex {
+    public:
+        void build(const std::string & str);
+        void extend(const char * data, size_t len, size_t offset);
+
+        size_t line(size_t pos) const;
+        size_t collumn(size_t pos) const;
+    private:
+        std::vector<uint32_t> starts; // Sources are capped to 4 GiB by the tokens anyway
+    };
+
+    class LogSink;
+
+    typedef void (* ExitFn)();  // Custom function for exiting
+    typedef void (* PanicFn)(); // Custom function for the panic state
+
     class Logger {
     public:
         enum Type {
@@ -70,31 +162,104 @@ namespace llama {
             Panic, 
         };
 
+        typedef void (* LogFn)(Type, const char * msg); // Custom function for logging
+
+        // A log as it was raised, its message is only formatted when something reads it. Arguments
+        // are copied in the order the format reads them (strings included, cut to fit), so nothing
+        // they pointed to has to outlive the log
+        struct Diagnostic {
+            Type       type;
+            ErrorCode  code;
+            LogSnippet snippet;
+            size_t     line;    // 0 when there's no snippet
+            size_t     collumn;
+
+            const char * fmt; // Always a literal, like every format given to the log macros
+            const char * d_file;
+            const char * d_func;
+            int          d_line;
+
+            char          source[LLAMA_LOG_SOURCE];
+            unsigned char args[LLAMA_LOG_ARGS];
+            size_t        args_size;
+
+            size_t message(char * buf, size_t size) const;
+            size_t format(char * buf, size_t size) const;
+        };
+
         Logger();
         ~Logger();
 
         void reset();
+        void clear();
         void set_source(const char * file);
         void set_snippet(LogSnippet m_snippet);
+        void set_lines(const LineIndex * m_lines);
         void set_debug(const char * file, int line, const char * function);
+        void set_code(ErrorCode m_code);
         void set_recoverable();
+        void set_muted();
+        void set_quiet();
+        void set_level(Type m_level);
+        void set_handlers(ExitFn m_exit_fn, PanicFn m_panic_fn, LogFn m_log_fn);
+        void set_sink(LogSink * m_sink);
 
         void log(Type type, const char * fmt, ...);
 
+        bool enabled(Type type) const;
         bool has_error();
 
+        size_t             size();
+        size_t             dropped();
+        const Diagnostic * at(size_t idx);
+
         std::string dump();
+
+        static void print(const Diagnostic & diag, LogFn log_fn);
     private:
+        void capture(Diagnostic & diag, Type type, const char * fmt, va_list args);
+
         const char * source;
         LogSnippet   snippet;
-        std::string  err;
 
-        bool recoverable;
+        const LineIndex * lines; // Line starts of the source being read, if any
+
+        // The last warnings and errors, oldest first from ring_start (the oldest ones are
+        // overwritten once it's full)
+        Diagnostic ring[LLAMA_LOG_RING];
+        size_t     ring_start;
+        size_t     ring_size;
+        size_t     ring_dropped;
+
+        // Kept across resets
+        Type    level; // Least severe type logged
+        bool    quiet; // Diagnostics are only kept, never printed
+        ExitFn  exit_fn;
+        PanicFn panic_fn;
+        LogFn   log_fn; // Gets the printed lines instead of stdout and stderr
+
+        LogSink * sink; // Prints in the background when set
+
+        bool recoverable; // Errors make the work fail instead of exiting
+        bool muted;       // Errors are only counted, for work that gets redone when it fails
+        bool errored;
+
+        ErrorCode code; // Of the log being raised
 
         const char * __d_file;
         const char * __d_func;
         int          __d_line;
     };
+
+    typedef Logger::LogFn LogFn;
+}
+
+static_assert(llama::Logger::Info == LLAMA_LOG_INFO && llama::Logger::Warning == LLAMA_LOG_WARNING && 
+              llama::Logger::SyntaxError == LLAMA_LOG_ERROR, "log levels must follow Logger::Type");
+
+// Checked before the arguments of a log are even evaluated, so it has to stay inline
+inline bool llama::Logger::enabled(Type type) const {
+    return type >= level && !muted;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,57 @@
+#ifndef LLAMA_FOLDER_H
+#define LLAMA_FOLDER_H
+
+#include <ast.h>
+#include <arena.h>
+#include <module.h>
+
+#include <cstdint>
+#include <cstddef>
+
+namespace llama {
+    // Constant folding pass, runs between the resolver and the code generator. Operators over
+    // literals are computed ahead of time and identities (x * 1, x + 0, !!b...) are dropped, but
+    // only where the runtime would give the exact same value: anything that raises an error on the
+    // runtime (mixed int and float, integer division by zero...) is left for the runner to report,
+    // and identities only apply to operands whose type is known without running them
+    class Folder {
+    public:
+        Folder();
+
+        void setup(Module * m_mod, Arena * m_arena);
+        void fold(Node * node);
+    private:
+        // What an expression is known to give before running it
+        enum class Known : unsigned char {
+            Nothing,
+            Null,
+            Bool,
+            Int,
+            Float,
+            String,
+        };
+
+        struct Constant {
+            Known        type;
+            bool         boolean;
+            int          integer;
+            double       decimal;
+            const char * str;
+        };
+
+        void   fold_block(BlockNode * node);
+        Node * fold_expr(Node * node, Known & known);
+        Node * fold_unary(UnaryNode * node, Known & known);
+        Node * fold_binary(BinaryNode * node, Known & known);
+
+        bool   constant(Node * node, Constant & value);
+        Node * make_constant(Node * at, const Constant & value);
+        bool   compute(Token::Type op, const Constant & a, const Constant & b, Constant & result);
+        bool   is_identity(Token::Type op, Node * operand, Known known, bool right);
+
+        Module * mod;
+        Arena  * arena;
+    };
+}
+
+#endif
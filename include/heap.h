@@ -0,0 +1,92 @@
+#ifndef LLAMA_HEAP_H
+#define LLAMA_HEAP_H
+
+#include <value.h>
+#include <allocator.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#define LLAMA_GC_BUCKETS 12 // Pause histogram buckets, bucket n counts pauses below 2^n microseconds
+
+namespace llama {
+    class VM;
+
+    // Owns every reference payload of a VM. Unreachable objects are reclaimed by a mark-sweep
+    // collector whose roots are the value stack (call frames included) and the globals, either all
+    // at once or incrementally in steps bounded by a pause budget
+    class Heap {
+    public:
+        enum State {
+            Idle,  // No cycle running
+            Mark,  // Tracing the gray objects
+            Sweep, // Freeing what stayed white
+        };
+
+        Heap(VM * m_vm, Allocator * m_allocator, size_t m_limit, bool m_incremental, size_t m_budget);
+        ~Heap();
+
+        HeapObject * alloc(Type type, const void * payload, size_t size);
+
+        void barrier(const Value & v);
+        void collect();
+        void step();
+        void fix_gray(size_t count);
+
+        State  get_state();
+        size_t get_used();
+        size_t get_limit();
+        size_t get_collections();
+        size_t get_max_pause();
+
+        Allocator * get_allocator();
+
+        const size_t * get_histogram();
+
+        std::string dump();
+    private:
+        void begin_cycle();
+        void end_cycle();
+        void work(bool bounded);
+
+        void mark_roots();
+        void shade(HeapObject * obj);
+        void trace(HeapObject * obj);
+        void record(size_t micros);
+
+        VM        * vm;
+        Allocator * allocator; // Owned by the heap
+
+        State state;
+
+        HeapObject * objects;  // Every allocation not waiting to be swept, linked through next
+        HeapObject * sweeping; // Allocations of the current cycle that weren't swept yet
+
+        std::vector<HeapObject *> gray; // Marked objects whose children weren't traced yet
+
+        size_t gray_cap;      // Fixed capacity of the gray stack (0 means it grows)
+        bool   gray_overflow; // Objects were marked without fitting in the gray stack
+
+        size_t used;        // Bytes in use, headers included
+        size_t limit;       // Hard ceiling in bytes (0 means unbounded)
+        size_t next_gc;     // Cycles start once this is crossed
+        size_t collections;
+
+        bool   incremental;
+        size_t budget;      // Pause budget of an incremental step, in microseconds
+
+        size_t pauses[LLAMA_GC_BUCKETS];      // Pauses of the running cycle
+        size_t last_pauses[LLAMA_GC_BUCKETS]; // Pauses of the last finished cycle
+        size_t max_pause;
+    };
+}
+
+// Dijkstra-style insertion barrier, every store into a heap object or a global goes through
+// this so that black objects never point at white ones while marking
+inline void llama::Heap::barrier(const Value & v) {
+    if (state == Mark && IS_REFTYPE(v.get_type()) && !v.get_object()->marked) shade(v.get_object());
+}
+
+#endif
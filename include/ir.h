@@ -2,6 +2,7 @@
 #define LLAMA_IR_H
 
 #include <bytecode.h>
+#include <module/symbol_pool.h>
 
 #include <cstdint>
 #include <cstddef>
@@ -41,6 +42,15 @@ namespace llama {
         std::string dump();
     };
 
+    // Instruction decoded at load time, with its operands and branch target already resolved
+    class DecodedInst {
+    public:
+        const void *  handler; // Filled by the runner, only used by the threaded dispatch
+        int32_t       args[3];
+        uint32_t      target;  // Absolute index of the next instruction when branching
+        unsigned char opcode;
+    };
+
     class IRBuilder {
     public:
         IRBuilder();
@@ -73,8 +83,12 @@ namespace llama {
         void _getproperty(int name, int idx);
         void _setindex(int idx);
         void _getindex(int idx);
-        void _newglobal(int name);
-        void _newlocal(int name);
+        void _newglobal(int slot);
+        void _newlocal(int slot);
+        void _getlocal(int slot);
+        void _setlocal(int slot);
+        void _getglobal_slot(int slot);
+        void _setglobal_slot(int slot);
         void _pop();
         void _popn(int n);
         void _add();
@@ -117,14 +131,15 @@ namespace llama {
 
         void _pushstring(std::string str);
         void _pushobject(std::string class_name);
-        void _setglobal(std::string name, int idx);
-        void _getglobal(std::string name);
-        void _setproperty(std::string name, int idx);
-        void _getproperty(std::string name, int idx);
-        void _newglobal(std::string name);
-        void _newlocal(std::string name);
-        void _refglobal(std::string name);
-        void _refproperty(std::string name);
+        void _setglobal(Symbol name, int idx);
+        void _getglobal(Symbol name);
+        void _setproperty(Symbol name, int idx);
+        void _getproperty(Symbol name, int idx);
+        void _newglobal(Symbol name);
+        void _getglobal_slot(Symbol name);
+        void _setglobal_slot(Symbol name);
+        void _refglobal(Symbol name);
+        void _refproperty(Symbol name);
         void _typecheck(std::string type);
 
         void push_if();
@@ -151,6 +166,7 @@ namespace llama {
         size_t      read_inst(std::vector<unsigned char> & data, size_t i);
         void        build(std::vector<unsigned char> & data);
         size_t      build_inst(std::vector<unsigned char> & data, size_t i);
+        bool        decode(std::vector<DecodedInst> & code);
 
         void dump();
     private:
@@ -2,16 +2,25 @@
 #define LLAMA_LEXER_H
 
 #include <error.h>
+#include <module/symbol_pool.h>
 
 #include <cstdint>
 #include <cstddef>
+#include <cstdio>
 #include <string>
 #include <vector>
+#include <stack>
+#include <thread>
+#include <type_traits>
+
+#define LLAMA_LEX_CHUNK  (64 * 1024) // Bytes read from a source file at once
+#define LLAMA_LEX_WINDOW 4096        // Released tokens piled up before they're dropped from the window
+#define LLAMA_LEX_PARALLEL_MIN (1024 * 1024) // Smallest source worth splitting between threads
 
 namespace llama {
     class Token {
     public:
-        enum class Type {
+        enum class Type : unsigned char {
             Unknown, 
 
             Label, 
@@ -90,11 +99,22 @@ namespace llama {
             CallEnd, 
         };
 
-        Token(Type m_type = Type::Unknown, LogSnippet m_snippet = LogSnippet());
+        // What the lexer made of the text, so nothing after it has to look at it again
+        union Data {
+            Symbol symbol;  // Labels, interned (ERROR_IDX_BIN when they weren't)
+            int    integer; // Integers, whatever their radix
+            double decimal; // Decimals
+        };
+
+        Token(Type m_type = Type::Unknown, uint32_t m_start = UINT32_MAX, uint32_t m_length = 0);
 
-        Type        type;
-        std::string lexeme;
-        LogSnippet  snippet;
+        // Tokens don't own their text, they only point into the source of their lexer
+        Type     type;
+        uint32_t start;  // Byte offset in the source (UINT32_MAX for tokens out of nowhere)
+        uint32_t length; // Length in bytes, quotes included for strings
+        Data     data;
+
+        LogSnippet snippet();
 
         bool is_op();
         bool is_arithmetic();
@@ -123,40 +143,106 @@ namespace llama {
         const char * type_str();
     };
 
+    static_assert(std::is_trivially_copyable<Token>::value, "tokens are copied around by value");
+
     class Analyser;
 
+    // Tokens are read on demand, as at() and has() ask for them, and only a window of them is kept
+    // around: once the reader is done with everything before a token it calls release(), and those
+    // tokens (along with the source text under them, when reading from a file) get dropped
     class Lexer {
     public:
         Lexer();
         ~Lexer();
 
-        void parse(Logger * m_log, std::string m_str);
+        void parse(Logger * m_log, std::string m_str, size_t threads = 1);
+        void parse(Logger * m_log, FILE * m_file);
+        void set_symbols(SymbolPool * m_symbol_pool);
+
+        size_t      size();
+        bool        has(size_t pos);
+        Token       at(size_t pos);
+        void        release(size_t pos);
+        std::string lexeme(Token token);
 
         void dump();
     private:
-        void   read_str();
+        bool   read_more();
+        void   read_end();
+        void   read_chunk(size_t pos);
+        void   read_parallel(size_t threads);
+        void   read_batch();
+        void   drop_batches();
+        void   compact();
+
+        std::vector<size_t> split(size_t count);
+
+        size_t skip_space(size_t pos);
+        size_t find_char(size_t pos, char c);
+
         size_t read_comment(size_t start);
         size_t read_number(size_t start);
         size_t read_string(size_t start);
         size_t read_op(size_t start);
         size_t read_label(size_t start);
 
-        size_t search_decimal(size_t start, bool & has_dot);
+        size_t search_decimal(size_t start, bool & is_decimal);
         size_t search_hexadecimal(size_t start);
         size_t search_octal(size_t start);
         size_t search_binary(size_t start);
 
-        void  refactor();
+        void  refactor(Token token, Token next);
         Token refactor_keyword(Token token, size_t pos);
 
+        bool  more(size_t pos);
         char  seek(size_t pos);
         Token seek_token(size_t pos);
-        void  push(size_t pos, Token token);
-
-        std::string        str;
-        std::vector<Token> tokens;
+        void  push(size_t start, size_t end, Token token);
+        void  hold(Token token);
+        void  append(Token token);
+
+        // Loaded part of the source, positions while reading are relative to it and tokens store
+        // them as absolute offsets
+        std::string str;
+        size_t      str_base; // Offset of the first loaded character
+        size_t      cursor;   // Where the next lexeme starts
+        FILE *      file;     // Where the rest of the source comes from (nullptr once it's all loaded)
+        bool        done;
+        LineIndex   lines;
+
+        // Tokens are stored as a structure of arrays, Token is only a view over one entry
+        std::vector<Token::Type> types;
+        std::vector<uint32_t>    starts;
+        std::vector<uint32_t>    lengths;
+        std::vector<Token::Data> values;
+        size_t                   token_base; // Index of the first token in the window
+        size_t                   released;   // Tokens before this one aren't needed anymore
+
+        // Chunks of the source lexed ahead on other threads, without refactoring, each one waited
+        // for and refactored here in order once reading gets to it
+        struct Batch {
+            Lexer *     lexer = nullptr;
+            Logger *    log   = nullptr; // Muted, only tells whether the chunk stopped at an error
+            std::thread thread;
+        };
 
-        Logger * log;
+        std::vector<Batch> batches;
+        size_t             batch;      // Next batch to read from
+        size_t             batch_pos;  // Next token of that batch
+        size_t             serial_end; // Where the first batch starts, the chunk before is read here
+        bool               raw; // Only lexes, pushed tokens are appended as they are
+
+        // Refactoring state, carried from one token to the next while reading
+        std::stack<Token> expects; // Closing tokens still to be found
+        Token             last;
+        Token             prev;    // Last appended, call markers included
+        Token             pending; // Read but not refactored yet
+        bool              is_fn;
+        bool              has_pending;
+        bool              failed;
+
+        Logger *     log;
+        SymbolPool * symbol_pool; // Where labels are interned as they're read (none if nullptr)
 
         friend Analyser;
     };
@@ -0,0 +1,59 @@
+#ifndef LLAMA_LOG_SINK_H
+#define LLAMA_LOG_SINK_H
+
+#include <error.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace llama {
+    // Hands diagnostics over to a background thread that formats and writes them (or gives them to
+    // a LogFn), so whoever logs never waits on I/O. Any thread can push, the queue is a bounded
+    // ring of slots claimed with a CAS on its head, and when it's full the record is dropped and
+    // counted instead of waiting for room
+    class LogSink {
+    public:
+        LogSink(size_t m_capacity, LogFn m_log_fn = nullptr);
+        ~LogSink();
+
+        bool push(const Logger::Diagnostic & diag);
+        void flush();
+
+        size_t dropped();
+        size_t written();
+    private:
+        struct Slot {
+            std::atomic<size_t> seq; // Position the slot can be written at, or read at once it's + 1
+            Logger::Diagnostic  diag;
+        };
+
+        bool pop(Logger::Diagnostic & diag);
+        void consume();
+
+        Slot * slots;
+        size_t mask;
+
+        std::atomic<size_t> head; // Next position to be claimed by a producer
+        std::atomic<size_t> tail; // Next position to be read, only moved by the consumer
+
+        std::atomic<size_t> drops;
+        std::atomic<size_t> writes;
+
+        LogFn log_fn;
+
+        // The consumer sleeps when there's nothing to write, producers only wake it up when it does
+        std::thread             thread;
+        std::mutex              mutex;
+        std::condition_variable wake;
+        std::atomic<bool>       sleeping;
+        std::atomic<bool>       stopping;
+
+        std::atomic<std::thread::id> consumer; // Flushing from it (through a LogFn) drains inline
+    };
+}
+
+#endif
@@ -4,6 +4,8 @@
 #include <module/const_pool.h>
 #include <module/class_pool.h>
 #include <module/func_pool.h>
+#include <module/global_pool.h>
+#include <module/symbol_pool.h>
 
 #include <cstdint>
 #include <cstddef>
@@ -21,6 +23,11 @@ namespace llama {
         ClassPool    * get_classes();
         ConstantPool * get_constants();
         FunctionPool * get_functions();
+        GlobalPool   * get_globals();
+        SymbolPool   * get_symbols();
+
+        void   add_folded(size_t count);
+        size_t get_folded();
 
         void dump();
         void build(std::vector<unsigned char> & vec);
@@ -28,6 +35,10 @@ namespace llama {
         ClassPool    * classes;
         ConstantPool * consts;
         FunctionPool * funcs;
+        GlobalPool   * globals;
+        SymbolPool   * symbols;
+
+        size_t folded; // Instructions constant folding kept out of the module
     };
 }
 
@@ -6,8 +6,11 @@
 #include <vector>
 #include <string>
 
+#include <module/symbol_pool.h>
+
 namespace llama {
     class Module;
+    class VMRunner;
 
     class ConstantEntry {
     public:
@@ -45,17 +48,22 @@ namespace llama {
     class ConstantPool {
     public:
         size_t          get(ConstantEntry entry);
+        size_t          get_symbol(Symbol symbol);
         ConstantEntry * at(size_t idx);
+        Symbol          symbol(size_t idx);
         size_t          size();
 
         std::string     dump();
         unsigned char * build(size_t * m_size);
     private:
         std::vector<ConstantEntry> entries;
+        std::vector<size_t>        names;   // Constant holding the name of every symbol, once asked for
+        std::vector<Symbol>        symbols; // Symbol named by every constant (ERROR_IDX_BIN if unknown yet)
 
         Module * mod;
 
         friend Module;
+        friend VMRunner;
     };
 }
 
@@ -1,6 +1,9 @@
 #ifndef LLAMA_MODULE_FUNCPOOL_H
 #define LLAMA_MODULE_FUNCPOOL_H
 
+#include <ir.h>
+#include <module/symbol_pool.h>
+
 #include <cstdint>
 #include <cstddef>
 #include <string>
@@ -22,16 +25,24 @@ namespace llama {
             std::string field;
             std::string type;
             bool        optional;
+            Symbol      symbol; // Of the field
         };
 
-        void        set_name(std::string m_name);
+        void        set_name(std::string m_name, Symbol m_symbol);
         std::string get_name();
+        Symbol      get_symbol();
 
         std::vector<unsigned char> & get_data();
+        std::vector<DecodedInst>   & get_code();
+
+        bool decode(Module * mod);
         
         int  get_line();
         void set_line(int m_line);
 
+        size_t get_locals();
+        void   set_locals(size_t m_locals);
+
         void     push_arg(Argument arg);
         Argument get_arg(size_t idx);
         size_t   get_argc();
@@ -39,12 +50,15 @@ namespace llama {
         bool operator==(const FunctionEntry & other);
     private:
         std::string                name;
+        Symbol                     symbol;
         std::vector<Argument>      args;
         std::vector<unsigned char> data;
+        std::vector<DecodedInst>   code;
 
         ExternFunc ext;
 
-        int line;
+        int    line;
+        size_t locals; // Frame size, arguments included
     };
     
     class FunctionPool {
@@ -52,6 +66,7 @@ namespace llama {
         size_t          add(FunctionEntry & entry);
         size_t          get(std::string name);
         bool            has(std::string name);
+        bool            has(Symbol symbol);
         FunctionEntry * at(size_t idx);
         size_t          size();
 
@@ -60,6 +75,7 @@ namespace llama {
         std::string dump(size_t idx, bool show_code = false);
     private:
         std::vector<FunctionEntry> entries;
+        std::vector<size_t>        names; // Function named by every symbol (ERROR_IDX_BIN for none)
 
         Module * mod;
 
@@ -0,0 +1,36 @@
+#ifndef LLAMA_MODULE_GLOBALPOOL_H
+#define LLAMA_MODULE_GLOBALPOOL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+
+#include <module/symbol_pool.h>
+
+namespace llama {
+    class Module;
+
+    // Symbol -> slot side table, globals are accessed by slot at runtime and only the host (and
+    // the disassembler) go through their names
+    class GlobalPool {
+    public:
+        size_t      get(Symbol symbol);
+        size_t      get(std::string name);
+        size_t      find(Symbol symbol);
+        size_t      find(std::string name);
+        std::string name(size_t idx);
+        size_t      size();
+
+        std::string dump();
+    private:
+        std::vector<Symbol> symbols; // Symbol of every slot
+        std::vector<size_t> slots;   // Slot of every symbol (ERROR_IDX_BIN for the ones without)
+
+        Module * mod;
+
+        friend Module;
+    };
+}
+
+#endif
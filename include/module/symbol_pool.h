@@ -0,0 +1,42 @@
+#ifndef LLAMA_MODULE_SYMBOLPOOL_H
+#define LLAMA_MODULE_SYMBOLPOOL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+
+namespace llama {
+    class Module;
+
+    typedef uint32_t Symbol; // Interned identifier (ERROR_IDX_BIN for none)
+
+    // Every distinct identifier of a module gets a symbol once, when the lexer first reads it, and
+    // from then on names are keyed (and compared) by it instead of by their text
+    class SymbolPool {
+    public:
+        SymbolPool();
+
+        Symbol      get(const char * str, size_t length);
+        Symbol      get(std::string str);
+        Symbol      find(const char * str, size_t length);
+        Symbol      find(std::string str);
+        std::string name(Symbol symbol);
+        size_t      size();
+
+        std::string dump();
+    private:
+        size_t probe(const char * str, size_t length, uint32_t hash);
+        void   grow();
+
+        std::vector<std::string> names;
+        std::vector<uint32_t>    hashes;
+        std::vector<Symbol>      slots; // Open addressing table of symbols, by hash
+
+        Module * mod;
+
+        friend Module;
+    };
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef LLAMA_RESOLVER_H
+#define LLAMA_RESOLVER_H
+
+#include <ast.h>
+#include <module.h>
+#include <error.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace llama {
+    // Scope resolution pass, gives every local its frame slot and tells every name whether it's
+    // one of them or a global. Its scopes outlive a single statement, so the ones of the module
+    // body are opened and closed by whoever feeds it
+    class Resolver {
+    public:
+        Resolver();
+
+        void   setup(Module * m_mod, Logger * m_log);
+        Status resolve(Node * node);
+
+        void   begin_scope();
+        void   end_scope();
+        size_t get_max_locals();
+    private:
+        Status resolve_block(BlockNode * node);
+        Status resolve_fn(FnNode * node);
+
+        struct Local {
+            Symbol name;
+            size_t depth;
+        };
+
+        size_t declare_local(Symbol name);
+        size_t find_local(Symbol name);
+
+        std::vector<Local> locals; // Locals of the function being resolved, indexed by their slot
+        size_t             depth;
+        size_t             max_locals;
+
+        Module * mod;
+        Logger * log;
+    };
+}
+
+#endif
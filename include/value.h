@@ -5,6 +5,7 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <cstring>
 #include <string>
 
 #define IS_REFTYPE(type)    ((type) >= llama::Type::String && (type) <= llama::Type::Userdata)
@@ -27,62 +28,243 @@ namespace llama {
 
     class VM;
     class VMRunner;
+    class Heap;
+
+    // Header shared by every reference type, the payload is allocated right after it. Objects
+    // are owned by the VM heap, values only point at them
+    struct HeapObject {
+        HeapObject * next;   // Next allocation of the heap
+        size_t       size;   // Size of the payload in bytes
+        Type         type;   // Boxed values only keep the pointer, so the exact type lives here
+        bool         marked; // Reached during the current collection
+    };
 
     class Value {
     public:
         Value();
-        Value(const Value & value);
-        ~Value();
 
         Value(bool v);
         Value(int v);
         Value(double v);
         Value(size_t idx, Type m_type);
+        Value(HeapObject * obj);
 
-        Value _add(Value other);
-        Value _sub(Value other);
-        Value _mul(Value other);
-        Value _div(Value other);
-        Value _mod(Value other);
-        Value _pow(Value other);
-        Value _eq(Value other);
-        Value _lt(Value other);
-        Value _le(Value other);
-        Value _gt(Value other);
-        Value _ge(Value other);
-        Value _ne(Value other);
-        Value _negate();
-        Value _promote(); // why does this even exist?
+        Value _add(const Value & other) const;
+        Value _sub(const Value & other) const;
+        Value _mul(const Value & other) const;
+        Value _div(const Value & other) const;
+        Value _mod(const Value & other) const;
+        Value _pow(const Value & other) const;
+        Value _eq(const Value & other) const;
+        Value _lt(const Value & other) const;
+        Value _le(const Value & other) const;
+        Value _gt(const Value & other) const;
+        Value _ge(const Value & other) const;
+        Value _ne(const Value & other) const;
+        Value _negate() const;
+        Value _promote() const; // why does this even exist?
         Value _sizeof();
         Value _lenof();
         Value _typeof();
         Value _instanceof();
 
+        Type         get_type() const;
+        bool         get_bool() const;
+        int          get_int() const;
+        double       get_float() const;
+        size_t       get_idx() const;
+        HeapObject * get_object() const;
+
+        void * payload() const;
+
         size_t size();
 
-        Value       convert(std::string conv_type);
+        Value       convert(const char * conv_type);
         Value       as_ref();
         std::string as_string();
 
-        const char * type_str();
+        const char * type_str() const;
     private:
-        struct Userdata {
-            void * __ptr;
-            size_t __size;
-        };
+#ifdef LLAMA_NAN_BOXING
+        // Every double that isn't a boxed NaN is stored as is, everything else lives in the
+        // payload of a negative quiet NaN: a 3 bits tag followed by 48 bits of data
+        static const uint64_t BOX_MASK    = 0xfff8000000000000ull;
+        static const uint64_t TAG_SHIFT   = 48;
+        static const uint64_t TAG_MASK    = 0x0007000000000000ull;
+        static const uint64_t DATA_MASK   = 0x0000ffffffffffffull;
+        static const uint64_t CANONIC_NAN = 0x7ff8000000000000ull;
+
+        enum Tag : uint64_t { TagNull, TagBool, TagInt, TagFunction, TagDynamic, TagVoid, TagObject = 7 };
 
+        static uint64_t box(Tag tag, uint64_t data);
+
+        bool     is_boxed() const;
+        bool     is_object() const;
+        Tag      get_tag() const;
+        uint64_t get_data() const;
+
+        uint64_t bits;
+#else
         Type type;
         union {
-            bool     __bool;
-            int      __int;
-            double   __float;
-            size_t   __idx;
-            Userdata __udata;
+            bool         __bool;
+            int          __int;
+            double       __float;
+            size_t       __idx;
+            HeapObject * __obj;
         } data;
+#endif
 
         friend VM;
         friend VMRunner;
+        friend Heap;
+    };
+}
+
+/* -=- Representation -=- */
+// Everything below runs on every stack operation, so it is kept inline (values are plain handles,
+// copying one never touches the heap)
+#ifdef LLAMA_NAN_BOXING
+static_assert(sizeof(void *) == 8, "NaN-boxing needs 48 bits pointers in a 64 bits address space");
+static_assert(sizeof(llama::Value) == 8, "boxed values must fit in 64 bits");
+
+inline uint64_t llama::Value::box(Tag tag, uint64_t data) {
+    return BOX_MASK | ((uint64_t)(tag) << TAG_SHIFT) | (data & DATA_MASK);
+}
+
+inline bool llama::Value::is_boxed() const {
+    return (bits & BOX_MASK) == BOX_MASK;
+}
+
+inline bool llama::Value::is_object() const {
+    return (bits & (BOX_MASK | TAG_MASK)) == (BOX_MASK | TAG_MASK);
+}
+
+inline llama::Value::Tag llama::Value::get_tag() const {
+    return (Tag)((bits & TAG_MASK) >> TAG_SHIFT);
+}
+
+inline uint64_t llama::Value::get_data() const {
+    return bits & DATA_MASK;
+}
+
+inline llama::Value::Value() {
+    bits = box(TagNull, 0);
+}
+
+inline llama::Value::Value(bool v) {
+    bits = box(TagBool, v);
+}
+
+inline llama::Value::Value(int v) {
+    bits = box(TagInt, (uint32_t)(v));
+}
+
+inline llama::Value::Value(double v) {
+    // NaNs are canonicalized so that they never look like a boxed value
+    if (v != v) bits = CANONIC_NAN;
+    else        memcpy(&bits, &v, sizeof(bits));
+}
+
+inline llama::Value::Value(size_t idx, Type m_type) {
+    switch (m_type) {
+        case Type::Function: bits = box(TagFunction, idx); break;
+        case Type::Dynamic:  bits = box(TagDynamic, idx);  break;
+        case Type::Void:     bits = box(TagVoid, idx);     break;
+        default:             bits = box(TagNull, 0);       break;
+    }
+}
+
+inline llama::Value::Value(HeapObject * obj) {
+    bits = box(TagObject, (uint64_t)((uintptr_t)(obj)));
+}
+
+inline llama::Type llama::Value::get_type() const {
+    static const Type tag_types[] = { 
+        Type::Null, Type::Bool, Type::Int, Type::Function, Type::Dynamic, Type::Void, Type::Null, Type::Null 
     };
+
+    if (!is_boxed()) return Type::Float;
+    if (is_object()) return get_object()->type;
+    return tag_types[get_tag()];
 }
 
+inline bool llama::Value::get_bool() const {
+    return get_data() != 0;
+}
+
+inline int llama::Value::get_int() const {
+    return (int)((uint32_t)(get_data()));
+}
+
+inline double llama::Value::get_float() const {
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+inline size_t llama::Value::get_idx() const {
+    return (size_t)(get_data());
+}
+
+inline llama::HeapObject * llama::Value::get_object() const {
+    return (HeapObject *)((uintptr_t)(get_data()));
+}
+#else
+inline llama::Value::Value() {
+    type = Type::Null;
+    data = { 0 };
+}
+
+inline llama::Value::Value(bool v) {
+    type        = Type::Bool;
+    data.__bool = v;
+}
+
+inline llama::Value::Value(int v) {
+    type       = Type::Int;
+    data.__int = v;
+}
+
+inline llama::Value::Value(double v) {
+    type         = Type::Float;
+    data.__float = v;
+}
+
+inline llama::Value::Value(size_t idx, Type m_type) {
+    type       = m_type;
+    data.__idx = idx;
+}
+
+inline llama::Value::Value(HeapObject * obj) {
+    type       = obj->type;
+    data.__obj = obj;
+}
+
+inline llama::Type llama::Value::get_type() const {
+    return type;
+}
+
+inline bool llama::Value::get_bool() const {
+    return data.__bool;
+}
+
+inline int llama::Value::get_int() const {
+    return data.__int;
+}
+
+inline double llama::Value::get_float() const {
+    return data.__float;
+}
+
+inline size_t llama::Value::get_idx() const {
+    return data.__idx;
+}
+
+inline llama::HeapObject * llama::Value::get_object() const {
+    return data.__obj;
+}
+
+#endif
+
 #endif
\ No newline at end of file
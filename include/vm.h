@@ -2,26 +2,29 @@
 #define LLAMA_VM_H
 
 #include <error.h>
+#include <log_sink.h>
 #include <value.h>
+#include <heap.h>
 #include <module.h>
+#include <lexer.h>
 
 #include <cstdint>
 #include <cstddef>
 #include <string>
 #include <vector>
-#include <map>
 
-#define REAL_IDX(idx) (size_t)((idx) < 0 ? stack.size() + (idx) : (idx))
+#define REAL_IDX(idx) (size_t)((idx) < 0 ? (sp - stack) + (idx) : (idx))
 
 #define LLAMA_CFG_NOSTDLIBS  (1 << 0) // Disables inclusion of the standard library
 #define LLAMA_CFG_STRICTMODE (1 << 1) // Compilation is stricter
 #define LLAMA_CFG_NOMODULES  (1 << 2) // Don't search for modules
+#define LLAMA_CFG_RECOVER    (1 << 3) // Errors make loads and calls fail instead of exiting
+#define LLAMA_CFG_INCGC      (1 << 4) // Collects incrementally, within gc_budget per step
+#define LLAMA_CFG_QUIET      (1 << 5) // Diagnostics are only kept for the host, never printed
+#define LLAMA_CFG_ASYNCLOG   (1 << 6) // Diagnostics are printed (or handed to log) by a background thread
 
 namespace llama {
-    typedef void (* ExitFn)();                              // Custom function for exiting
-    typedef void (* PanicFn)();                             // Custom function for the panic state
-    typedef void (* LogFn)(Logger::Type, const char * msg); // Custom function for logging
-    typedef void (* FormatFn)(const char * fmt, ...);       // Custom function for formatting
+    typedef void (* FormatFn)(const char * fmt, ...); // Custom function for formatting
 
     struct VMConfig {
         ExitFn   exit   = nullptr;
@@ -29,15 +32,44 @@ namespace llama {
         LogFn    log    = nullptr;
         FormatFn format = nullptr;
 
+        // Backing memory of heap objects, the per-VM pool allocator is used when alloc is null.
+        // free may be left null for arenas that are released all at once by the embedder
+        AllocFn alloc      = nullptr;
+        FreeFn  free       = nullptr;
+        void *  alloc_data = nullptr; // Passed as is to alloc and free
+
         short  flags        = 0;
-        size_t memory_limit = 1024; // Size is defined in kilobytes
+        size_t memory_limit = 1024; // Size is defined in kilobytes (0 for no limit)
+        size_t stack_size   = 1024; // Size is defined in values
+        size_t call_depth   = 256;  // Maximum number of nested script calls
+        size_t gc_budget    = 500;  // Pause budget of incremental collections in microseconds
+        size_t global_count = 256;  // Capacity of the globals table inside a fixed memory block
+        size_t lex_threads  = 1;    // Threads splitting the lexing of big sources (1 lexes serially)
+        size_t log_queue    = 256;  // Records waiting for the background log thread before they're dropped
+
+        // Least severe logs printed, the ones below LLAMA_LOG_LEVEL aren't even compiled in
+        Logger::Type log_level = (Logger::Type)(LLAMA_LOG_LEVEL);
+
+        // Fixed memory block the whole runtime lives in (stack, call frames, globals and heap),
+        // the system allocator is never called at runtime when it is set
+        void * memory      = nullptr;
+        size_t memory_size = 0;     // Size is defined in bytes
+    };
+
+    // Activation record of a running script function
+    struct CallFrame {
+        FunctionEntry * func;
+        DecodedInst   * code;
+        DecodedInst   * ret;    // Where the caller resumes
+        Value         * base;   // First argument, the other locals follow
+        size_t          locals; // Frame size, arguments included
     };
 
     class VMRunner;
 
     class VM {
     public:
-        VM();
+        VM(VMConfig m_config = VMConfig());
         VM(const VM & vm);
         ~VM();
 
@@ -66,20 +98,40 @@ namespace llama {
 
         Value  * get(int idx);
         Module * get_module();
+        Heap   * get_heap();
+        Logger * get_logger();
+        LogSink * get_sink();
 
         void dump();
     private:
-        Status read(std::string str);
+        Status read(Lexer & lex);
+
+        bool reserve_globals(size_t count);
+        bool has_memory(); // Fails with OutOfMemory when the memory block couldn't be carved
+        void setup_sink();
+        void setup_memory();
 
         void exec();
 
-        Logger * log;
-        Module * module;
+        VMConfig config;
+
+        Logger  * log;
+        LogSink * sink; // Only with LLAMA_CFG_ASYNCLOG
+        Module  * module;
+        Heap    * heap;
+
+        Value * stack; // Fixed-size value stack, allocated once per VM
+        Value * sp;    // Next free slot of the stack
 
-        std::vector<Value>           stack;
-        std::map<std::string, Value> globals;
+        CallFrame * frames; // Fixed-size call stack, allocated once per VM
+        CallFrame * fp;     // Next free frame
+        
+        Value * globals;      // Indexed by the slots of the module's global pool
+        size_t  global_count; // Slots in use
+        size_t  global_cap;   // Slots available before the table has to grow
 
         friend VMRunner;
+        friend Heap;
     };
 }
 
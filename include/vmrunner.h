@@ -18,9 +18,9 @@ namespace llama {
         ~VMRunner();
 
         Status exec(size_t argc, bool pop = false);
-
-        size_t do_inst(size_t i);
     private:
+        Status run(size_t argc, bool pop);
+
         VM * vm;
     };
 }
@@ -0,0 +1,250 @@
+/* -=============
+     Includes
+   =============- */
+
+#include <allocator.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/* -==============
+     Internals
+   ==============- */
+
+namespace llama {
+    static constexpr size_t class_sizes[LLAMA_POOL_CLASSES] = {
+        32, 48, 64, 80, 96, 128, 160, 192, 256, 320, 384, 512
+    };
+
+    // Size class of every 16 bytes step up to LLAMA_POOL_MAX_SIZE
+    static constexpr unsigned char class_steps[LLAMA_POOL_MAX_SIZE / 16 + 1] = {
+        0, 0, 0, 1, 2, 3, 4, 5, 5, 6, 6, 7, 7, 8, 8, 8, 8,
+        9, 9, 9, 9, 10, 10, 10, 10, 11, 11, 11, 11, 11, 11, 11, 11,
+    };
+
+    static_assert(class_sizes[LLAMA_POOL_CLASSES - 1] == LLAMA_POOL_MAX_SIZE, "the last class must hold the biggest pooled block");
+
+    // Big blocks carved from a region start with a header holding their capacity, 16 bytes so
+    // that the payload keeps its alignment. Free ones are only split when what's left can still
+    // serve a big allocation
+    static constexpr size_t large_header    = 16;
+    static constexpr size_t large_min_block = large_header + LLAMA_POOL_MAX_SIZE + 16;
+}
+
+/* -====================
+     Allocator class
+   ====================- */
+
+/* -=- (Con/des)tructors -=- */
+llama::Allocator::Allocator(AllocFn m_alloc_fn, FreeFn m_free_fn, void * m_user) {
+    alloc_fn = m_alloc_fn;
+    free_fn  = m_free_fn;
+    user     = m_user;
+    stats    = AllocStats();
+
+    large_free   = nullptr;
+    region_start = nullptr;
+    region_cur   = nullptr;
+    region_end   = nullptr;
+
+    memset(free_lists, 0, sizeof(free_lists));
+}
+
+llama::Allocator::Allocator(void * region, size_t size) : Allocator() {
+    region_start = (char *)(region);
+    region_cur   = region_start;
+    region_end   = region_start + size;
+}
+
+llama::Allocator::~Allocator() {
+    for (void * slab : slabs) free(slab);
+}
+
+/* -=- Allocation -=- */
+void * llama::Allocator::alloc(size_t size) {
+    void * ptr = nullptr;
+
+    if (alloc_fn != nullptr) {
+        ptr = alloc_fn(user, size);
+        if (ptr != nullptr) stats.reserved += size;
+    } else if (size > LLAMA_POOL_MAX_SIZE) {
+        ptr = alloc_large(size);
+    } else {
+        size_t cls = class_of(size);
+
+        // Refills an empty class, with a whole slab from the system or a single block from the
+        // region (so that a fixed region isn't split between classes ahead of time)
+        if (free_lists[cls] == nullptr) {
+            size_t block = class_sizes[cls];
+
+            if (region_start != nullptr) {
+                // Once the region is used up, a free block of a bigger class is better than failing
+                // (it stays in the smaller class from then on)
+                FreeBlock * free_block = (FreeBlock *)(carve(block));
+                for (size_t i = cls + 1; free_block == nullptr && i < LLAMA_POOL_CLASSES; ++i) {
+                    if (free_lists[i] == nullptr) continue;
+                    free_block    = free_lists[i];
+                    free_lists[i] = free_block->next;
+                }
+                if (free_block == nullptr) return nullptr;
+
+                free_block->next = nullptr;
+                free_lists[cls]  = free_block;
+            } else {
+                char * slab = (char *)(malloc(LLAMA_POOL_SLAB_SIZE));
+                if (slab == nullptr) return nullptr;
+                slabs.push_back(slab);
+                stats.reserved += LLAMA_POOL_SLAB_SIZE;
+
+                for (size_t off = 0; off + block <= LLAMA_POOL_SLAB_SIZE; off += block) {
+                    FreeBlock * free_block = (FreeBlock *)(slab + off);
+                    free_block->next = free_lists[cls];
+                    free_lists[cls]  = free_block;
+                }
+            }
+        }
+
+        ptr = free_lists[cls];
+        free_lists[cls] = free_lists[cls]->next;
+    }
+
+    if (ptr == nullptr) return nullptr;
+
+    ++stats.allocations;
+    stats.in_use += size;
+
+    return ptr;
+}
+
+void * llama::Allocator::alloc_large(size_t size) {
+    if (region_start == nullptr) {
+        void * ptr = malloc(size);
+        if (ptr != nullptr) stats.reserved += size;
+        return ptr;
+    }
+
+    // First fit over the blocks given back, the tail of a block too big stays in the list
+    size = large_header + ((size + 15) & ~(size_t)(15));
+
+    FreeBlock * block = nullptr;
+    for (FreeBlock ** it = &large_free; * it != nullptr; it = &(* it)->next) {
+        if ((* it)->size < size) continue;
+
+        block = * it;
+        if (block->size - size >= large_min_block) {
+            FreeBlock * rest = (FreeBlock *)((char *)(block) + size);
+            rest->next  = block->next;
+            rest->size  = block->size - size;
+            block->size = size;
+            * it = rest;
+        } else {
+            * it = block->next;
+        }
+        break;
+    }
+
+    if (block == nullptr) {
+        block = (FreeBlock *)(carve(size));
+        if (block == nullptr) return nullptr;
+        block->size = size;
+    }
+
+    return (char *)(block) + large_header;
+}
+
+void llama::Allocator::release_large(FreeBlock * block) {
+    static_assert(sizeof(FreeBlock) <= large_header, "a free block must fit in the header of a big block");
+
+    // The list is kept sorted by address so that neighbours can be merged back together
+    FreeBlock ** prev_link = nullptr;
+    FreeBlock ** it        = &large_free;
+    while (* it != nullptr && * it < block) {
+        prev_link = it;
+        it        = &(* it)->next;
+    }
+
+    block->next = * it;
+    * it = block;
+
+    FreeBlock * next = block->next;
+    if (next != nullptr && (char *)(block) + block->size == (char *)(next)) {
+        block->size += next->size;
+        block->next  = next->next;
+    }
+
+    if (prev_link != nullptr && (char *)(* prev_link) + (* prev_link)->size == (char *)(block)) {
+        (* prev_link)->size += block->size;
+        (* prev_link)->next  = block->next;
+
+        block = * prev_link;
+        it    = prev_link;
+    }
+
+    // A block ending where carving resumes goes back to the untouched part of the region
+    if (block->next == nullptr && (char *)(block) + block->size == region_cur) {
+        * it = nullptr;
+        region_cur      = (char *)(block);
+        stats.reserved -= block->size;
+    }
+}
+
+void * llama::Allocator::carve(size_t size) {
+    if ((size_t)(region_end - region_cur) < size) return nullptr;
+
+    void * ptr = region_cur;
+    region_cur     += size;
+    stats.reserved += size;
+
+    return ptr;
+}
+
+void llama::Allocator::release(void * ptr, size_t size) {
+    if (ptr == nullptr) return;
+
+    ++stats.frees;
+    stats.in_use -= size;
+
+    if (alloc_fn != nullptr) {
+        if (free_fn != nullptr) free_fn(user, ptr, size);
+        stats.reserved -= size;
+    } else if (size > LLAMA_POOL_MAX_SIZE && region_start != nullptr) {
+        // The header knows the real capacity, which can be more than what was asked for
+        release_large((FreeBlock *)((char *)(ptr) - large_header));
+    } else if (size > LLAMA_POOL_MAX_SIZE) {
+        free(ptr);
+        stats.reserved -= size;
+    } else {
+        size_t cls = class_of(size);
+
+        FreeBlock * free_block = (FreeBlock *)(ptr);
+        free_block->next = free_lists[cls];
+        free_lists[cls]  = free_block;
+    }
+}
+
+size_t llama::Allocator::class_of(size_t size) {
+    return class_steps[(size + 15) / 16];
+}
+
+/* -=- (S/g)etters -=- */
+llama::AllocStats llama::Allocator::get_stats() {
+    return stats;
+}
+
+double llama::Allocator::get_fragmentation() {
+    // Share of the reserved memory that doesn't hold live data (rounding and cached free blocks)
+    if (stats.reserved == 0) return 0.0;
+    return 1.0 - (double)(stats.in_use) / (double)(stats.reserved);
+}
+
+/* -=- Base functions -=- */
+std::string llama::Allocator::dump() {
+    char line[128];
+    snprintf(line, sizeof(line), "%zu allocs, %zu frees, %zu bytes in use, %zu reserved (%.1f%% fragmented)\n",
+             stats.allocations, stats.frees, stats.in_use, stats.reserved, get_fragmentation() * 100.0);
+    return std::string(line);
+}
@@ -15,7 +15,6 @@
 #include <cstring>
 #include <string>
 #include <vector>
-#include <list>
 #include <map>
 
 /* -===================
@@ -35,17 +34,56 @@ void llama::Analyser::read(Module * m_mod, Logger * m_log, Lexer * m_lex) {
     ir = new IRBuilder();
     ir->set_module(m_mod);
 
+    resolver.setup(mod, log);
+    folder.setup(mod, &arena);
+    codegen.setup(mod, log, ir);
+
     FunctionEntry func;
-    if (parse_scope(0, false) != ERROR_IDX) {
+    if (parse_module() != ERROR_IDX) {
+        ir->_returnv();
+        func.set_locals(resolver.get_max_locals());
+
         size_t func_idx = mod->get_functions()->add(func);
         ir->build(mod->get_functions()->at(func_idx)->get_data());
     }
 
+    arena.reset();
+    pending.clear();
+
     delete ir;
 }
 
+size_t llama::Analyser::parse_module() {
+    INFO("analysing a module");
+
+    resolver.begin_scope();
+
+    // Each statement is resolved and emitted as soon as it's read, nothing looks back past it
+    size_t i = 0;
+    while (lex->has(i)) {
+        if (seek_token(i).type == Token::Type::RBrace) break;
+
+        Node * node = nullptr;
+        i = parse_statement(i, node);
+        if (i == ERROR_IDX) return ERROR_IDX;
+
+        if (node != nullptr) {
+            if (resolver.resolve(node) != Ok) return ERROR_IDX;
+            folder.fold(node);
+            if (codegen.emit(node) != Ok)     return ERROR_IDX;
+        }
+
+        arena.reset();
+        lex->release(i);
+    }
+
+    resolver.end_scope();
+
+    return i + 1;
+}
+
 /* -=- Statement cases -=- */
-size_t llama::Analyser::parse_statement(size_t pos) {
+size_t llama::Analyser::parse_statement(size_t pos, Node *& node) {
     INFO("analysing a statement at %zu", pos);
 
     size_t i = pos;
@@ -53,29 +91,37 @@ size_t llama::Analyser::parse_statement(size_t pos) {
     Token token = seek_token(i);
 
     if (token.is_expr() || token.is_operand()) {
-        i = parse_expr(i);
+        Node * expr = nullptr;
+        i = parse_expr(i, expr);
+        if (i == ERROR_IDX) return ERROR_IDX;
+
+        ExprStmtNode * stmt = make_node<ExprStmtNode>(Node::Kind::ExprStmt, token);
+        stmt->expr = expr;
+        node = stmt;
     } else if (token.is_decl()) {
-        i = parse_declaration(i);
+        i = parse_declaration(i, node);
     } else if (token.is_single()) {
-        i = parse_single(i);
+        i = parse_single(i, node);
     } else if (token.is_double()) {
-        i = parse_double(i);
+        i = parse_double(i, node);
     } else {
         switch (token.type) {
             case Token::Type::LBrace: {
-                i = parse_scope(i + 1);
+                BlockNode * block = nullptr;
+                i    = parse_scope(i + 1, block);
+                node = block;
                 break;
             }
             case Token::Type::If: {
-                i = parse_if(i + 1);
+                i = parse_if(i + 1, node);
                 break;
             }
             case Token::Type::While: {
-                i = parse_while(i + 1);
+                i = parse_while(i + 1, node);
                 break;
             }
             case Token::Type::Loop: {
-                i = parse_loop(i + 1);
+                i = parse_loop(i + 1, node);
                 break;
             }
             case Token::Type::Class: {
@@ -83,7 +129,7 @@ size_t llama::Analyser::parse_statement(size_t pos) {
                 break;
             }
             case Token::Type::Fn: {
-                i = parse_fn(i + 1);
+                i = parse_fn(i + 1, node);
                 break;
             }
             case Token::Type::End: {
@@ -91,13 +137,13 @@ size_t llama::Analyser::parse_statement(size_t pos) {
                 break;
             }
             case Token::Type::Else: {
-                log->set_snippet(token.snippet);
-                SYNTAXERROR("else statement without a matching if statement");
+                log->set_snippet(token.snippet());
+                SYNTAXERROR(UnexpectedToken, "else statement without a matching if statement");
                 return ERROR_IDX;
             }
             default: {
-                log->set_snippet(token.snippet);
-                SYNTAXERROR("unknown token type %s at %zu", token.type_str(), i);
+                log->set_snippet(token.snippet());
+                SYNTAXERROR(Internal, "unknown token type %s at %zu", token.type_str(), i);
                 return ERROR_IDX;
             }
         }
@@ -106,157 +152,173 @@ size_t llama::Analyser::parse_statement(size_t pos) {
     return i;
 }
 
-size_t llama::Analyser::parse_scope(size_t pos, bool initialize) {
+size_t llama::Analyser::parse_scope(size_t pos, BlockNode *& node, bool initialize) {
     INFO("analysing a scope block at %zu (initialize=%s)", pos, BOOLALPHA(initialize));
 
-    if (initialize) ir->push_block();
-    
+    // Made before the loop, which lets go of the tokens it's done with
+    BlockNode * block = make_node<BlockNode>(Node::Kind::Block, seek_token(pos));
+    block->block = initialize;
+
+    size_t base = pending.size();
+
     size_t i = pos;
-    while (i < lex->tokens.size()) {
-        if (lex->tokens[i].type == Token::Type::RBrace) break;
+    while (lex->has(i)) {
+        if (seek_token(i).type == Token::Type::RBrace) break;
 
-        i = parse_statement(i);
-        if (i == ERROR_IDX) return ERROR_IDX;
+        Node * stmt = nullptr;
+        i = parse_statement(i, stmt);
+        if (i == ERROR_IDX) {
+            pending.resize(base);
+            return ERROR_IDX;
+        }
+        if (stmt != nullptr) pending.push_back(stmt);
+
+        // Nothing looks back past a finished statement, so the lexer can let go of its tokens
+        lex->release(i);
     }
 
-    if (initialize) ir->end_block();
+    block->body = make_list(base);
+    node = block;
 
     return i + 1;
 }
 
-size_t llama::Analyser::parse_if(size_t pos) {
+size_t llama::Analyser::parse_if(size_t pos, Node *& node) {
     INFO("analysing an if statement at %zu", pos);
 
-    size_t i = parse_expr(pos, false, false, Token::Type::LBrace);
+    IfNode * stmt = make_node<IfNode>(Node::Kind::If, seek_token(pos));
+
+    size_t i = parse_expr(pos, stmt->cond, false, false, Token::Type::LBrace);
     if (i == ERROR_IDX) return ERROR_IDX;
 
-    ir->push_if();
-        i = parse_scope(i, false);
+    i = parse_scope(i + 1, stmt->then, false);
+    if (i == ERROR_IDX) return ERROR_IDX;
+
+    if (seek_token(i).type == Token::Type::Else) {
+        i = parse_scope(i + (seek_token(i + 1).type == Token::Type::LBrace ? 2 : 1), stmt->otherwise, false);
         if (i == ERROR_IDX) return ERROR_IDX;
+    }
 
-        if (seek_token(i).type == Token::Type::Else) {
-            ir->push_else();
+    node = stmt;
 
-            i = parse_scope(i + (seek_token(i + 1).type == Token::Type::LBrace ? 2 : 1), false);
-            if (i == ERROR_IDX) return ERROR_IDX;
-        }
-    ir->end_block();
-    
     return i;
 }
 
-size_t llama::Analyser::parse_while(size_t pos) {
+size_t llama::Analyser::parse_while(size_t pos, Node *& node) {
     INFO("analysing a while statement at %zu", pos);
-    ir->push_loop();
-        size_t i = parse_expr(pos, false, false, Token::Type::LBrace);
-        if (i == ERROR_IDX) return ERROR_IDX;
 
-        ir->push_if();
-            i = parse_scope(i, false);
-            if (i == ERROR_IDX) return ERROR_IDX;
+    WhileNode * stmt = make_node<WhileNode>(Node::Kind::While, seek_token(pos));
 
-            ir->_repeat();
-        ir->end_block();
+    size_t i = parse_expr(pos, stmt->cond, false, false, Token::Type::LBrace);
+    if (i == ERROR_IDX) return ERROR_IDX;
+
+    i = parse_scope(i + 1, stmt->body, false);
+    if (i == ERROR_IDX) return ERROR_IDX;
+
+    node = stmt;
 
-        ir->_break();
-    ir->end_block();
-    
     return i;
 }
 
-size_t llama::Analyser::parse_loop(size_t pos) {
+size_t llama::Analyser::parse_loop(size_t pos, Node *& node) {
     INFO("analysing a loop at %zu", pos);
-    ir->push_loop();
-        size_t i = parse_scope(pos + 1, false);
-        if (i == ERROR_IDX) return ERROR_IDX;
-    ir->end_block();
-    
+
+    LoopNode * stmt = make_node<LoopNode>(Node::Kind::Loop, seek_token(pos));
+
+    size_t i = parse_scope(pos + 1, stmt->body, false);
+    if (i == ERROR_IDX) return ERROR_IDX;
+
+    node = stmt;
+
     return i;
 }
 
-size_t llama::Analyser::parse_fn(size_t pos, bool expr) {
-    INFO("analysing a function at %zu (expr=%s)", pos, BOOLALPHA(expr));
-
-    FunctionEntry func;
+size_t llama::Analyser::parse_fn(size_t pos, Node *& node) {
+    INFO("analysing a function at %zu", pos);
 
     size_t i = pos;
 
     Token token = seek_token(i);
+
+    FnNode * fn = make_node<FnNode>(Node::Kind::Fn, token);
+    fn->name = ERROR_IDX_BIN;
+    fn->line = lex->lines.line(token.start);
+
     if (token.type == Token::Type::Label) {
-        if (mod->get_functions()->has(token.lexeme)) {
-            log->set_snippet(token.snippet);
-            SYNTAXERROR("the function %s already exists", token.lexeme.c_str());
+        fn->name = token.data.symbol;
+        token = seek_token(++i);
+    }
+
+    if (token.type != Token::Type::LParen) {
+        log->set_snippet(token.snippet());
+        SYNTAXERROR(UnexpectedToken, "unexpected token '%s', expected '('", lex->lexeme(token).c_str());
+        return ERROR_IDX;
+    }
+
+    // Arguments are counted first, so they can go straight into an array of the right size
+    size_t first = i + 1;
+
+    token = seek_token(++i);
+    while (lex->has(i) && token.type != Token::Type::RParen) {
+        if (token.type == Token::Type::Label) {
+            if (seek_token(i + 1).type == Token::Type::Colon) i += 2;
+            ++fn->argc;
+        } else if (token.type != Token::Type::Comma) {
+            log->set_snippet(token.snippet());
+            SYNTAXERROR(UnexpectedToken, "unexpected token '%s' in function arguments", lex->lexeme(token).c_str());
             return ERROR_IDX;
         }
-
-        func.set_name(token.lexeme);
         token = seek_token(++i);
     }
 
-    if (token.type == Token::Type::LParen) {
-        while (i < lex->tokens.size() && token.type != Token::Type::RParen) {
-            token = seek_token(i);
-            ++i;
+    fn->args = arena.make_array<FnNode::Argument>(fn->argc);
+    for (size_t j = first, arg = 0; arg < fn->argc; ++j) {
+        token = seek_token(j);
+        if (token.type != Token::Type::Label) continue;
+
+        fn->args[arg].symbol = token.data.symbol;
+        fn->args[arg].type   = nullptr;
+
+        if (seek_token(j + 1).type == Token::Type::Colon) {
+            std::string type = lex->lexeme(seek_token(j + 2));
+            fn->args[arg].type = arena.copy(type.c_str(), type.size());
+            j += 2;
         }
-        ++i;
-    } else {
-        log->set_snippet(token.snippet);
-        SYNTAXERROR("unexpected token '%s', expected '('", token.lexeme.c_str());
-        return ERROR_IDX;
+
+        ++arg;
     }
 
-    token = seek_token(i);
+    token = seek_token(++i);
 
     if (token.type != Token::Type::LBrace) {
-        IRBuilder * prev_ir = ir;
-        IRBuilder   fn_ir   = IRBuilder();
-        
-        fn_ir.set_module(prev_ir->get_module());
-
-        ir = &fn_ir;
-        i  = parse_scope(i + 1, true);
-        if (i != ERROR_IDX) {
-            ir->build(func.get_data());
-        }
-
-        ir = prev_ir;
-    } else {
-        log->set_snippet(token.snippet);
-        SYNTAXERROR("unexpected token '%s', expected block", token.lexeme.c_str());
+        log->set_snippet(token.snippet());
+        SYNTAXERROR(UnexpectedToken, "unexpected token '%s', expected block", lex->lexeme(token).c_str());
         return ERROR_IDX;
     }
-    
-    func.set_line(seek_token(pos).snippet.line);
 
-    size_t func_idx = mod->get_functions()->add(func);
-    if (expr) return func_idx;
+    i = parse_scope(i + 1, fn->body, true);
+    if (i == ERROR_IDX) return ERROR_IDX;
+
+    node = fn;
 
-    if (!func.get_name().empty()) {
-        ir->_newglobal(func.get_name());
-        ir->_refglobal(func.get_name());
-        ir->_pushfunc(func_idx);
-        ir->_refset(-2);
-        ir->_pop();
-    }
-    
     return i;
 }
 
-size_t llama::Analyser::parse_single(size_t pos) {
+size_t llama::Analyser::parse_single(size_t pos, Node *& node) {
     INFO("analysing a single at %zu", pos);
 
     Token token = seek_token(pos);
 
     switch (token.type) {
-        case Token::Type::Repeat: { ir->_repeat(); break; }
-        case Token::Type::Break:  { ir->_break();  break; }
+        case Token::Type::Repeat: { node = make_node<Node>(Node::Kind::Repeat, token); break; }
+        case Token::Type::Break:  { node = make_node<Node>(Node::Kind::Break,  token); break; }
         default:                  return ERROR_IDX;
     }
-    
+
     return pos + 2;
 }
 
-size_t llama::Analyser::parse_double(size_t pos) {
+size_t llama::Analyser::parse_double(size_t pos, Node *& node) {
     INFO("analysing a double at %zu", pos);
 
     Token token = seek_token(pos);
@@ -267,13 +329,13 @@ size_t llama::Analyser::parse_double(size_t pos) {
         /*case Token::Type::Import: {
             token = seek_token(i + 1);
             if (token.type != Token::Type::Label) {
-                log->set_snippet(token.snippet);
-                SYNTAXERROR("import name should be a label");
+                log->set_snippet(token.snippet());
+                SYNTAXERROR(ExpectedName, "import name should be a label");
                 return ERROR_IDX;
             }
-            if (ir->add_import(token.lexeme)) {
-                log->set_snippet(token.snippet);
-                SYNTAXWARN("'%s' was already imported", token.lexeme.c_str());
+            if (ir->add_import(lex->lexeme(token))) {
+                log->set_snippet(token.snippet());
+                SYNTAXWARN("'%s' was already imported", lex->lexeme(token).c_str());
             }
             i += 2;
             break;
@@ -281,522 +343,388 @@ size_t llama::Analyser::parse_double(size_t pos) {
         case Token::Type::Export: {
             token = seek_token(i + 1);
             if (token.type != Token::Type::Label) {
-                log->set_snippet(token.snippet);
-                SYNTAXERROR("export name should be a label");
+                log->set_snippet(token.snippet());
+                SYNTAXERROR(ExpectedName, "export name should be a label");
                 return ERROR_IDX;
             }
-            if (ir->add_export(token.lexeme)) {
-                log->set_snippet(token.snippet);
-                SYNTAXWARN("'%s' was already exported", token.lexeme.c_str());
+            if (ir->add_export(lex->lexeme(token))) {
+                log->set_snippet(token.snippet());
+                SYNTAXWARN("'%s' was already exported", lex->lexeme(token).c_str());
             }
             i += 2;
             break;
         }*/
         case Token::Type::Return: {
+            ReturnNode * stmt = make_node<ReturnNode>(Node::Kind::Return, token);
+
             token = seek_token(++i);
-            if (token.is_operand()) {
-                i = parse_expr(i, false);
+            if (token.is_operand() || token.is_expr() || token.type == Token::Type::LParen) {
+                i = parse_expr(i, stmt->value, false);
                 if (i == ERROR_IDX) return ERROR_IDX;
-                ir->_return();
-            } else if (token.type == Token::Type::End) {
-                ++i;
-                ir->_returnv();
-            } else {
-                log->set_snippet(token.snippet);
-                SYNTAXERROR("return statement missing expression or ';'");
+            } else if (token.type != Token::Type::End) {
+                log->set_snippet(token.snippet());
+                SYNTAXERROR(MissingEnd, "return statement missing expression or ';'");
                 return ERROR_IDX;
             }
-            ++i;
+
+            node = stmt;
             break;
         }
         default: return ERROR_IDX;
     }
-    
+
     return i + 1;
 }
 
-size_t llama::Analyser::parse_declaration(size_t pos, bool can_assign, Token::Type end) {
+size_t llama::Analyser::parse_declaration(size_t pos, Node *& node, bool can_assign, Token::Type end) {
     INFO("analysing a declaration at %zu (can_assign=%s, end=Token::%s)", pos, BOOLALPHA(can_assign), Token(end).type_str());
 
     size_t i = pos;
 
     Token token = seek_token(pos);
 
-    std::string ident;
-
     switch (token.type) {
         case Token::Type::Const: // TODO: are constant variables REALLY worthy implementing?
-        case Token::Type::Let: {
+        case Token::Type::Let:
+        case Token::Type::Var: {
             if (seek_token(i + 1).type != Token::Type::Label) {
-                log->set_snippet(token.snippet);
-                SYNTAXERROR("missing identifier in declaration");
+                log->set_snippet(token.snippet());
+                SYNTAXERROR(ExpectedName, "missing identifier in declaration");
+                return ERROR_IDX;
             }
-
-            token = seek_token(++i);
-            ir->_newlocal(token.lexeme);
-            ident = token.lexeme;
             break;
         }
-        case Token::Type::Var: {
-            if (seek_token(i + 1).type != Token::Type::Label) {
-                log->set_snippet(token.snippet);
-                SYNTAXERROR("missing identifier in declaration");
-            }
+        default: return ERROR_IDX;
+    }
 
-            token = seek_token(++i);
+    bool local = token.type != Token::Type::Var;
 
-            ir->_newglobal(token.lexeme);
-            ident = token.lexeme;
-            break;
+    token = seek_token(++i);
+
+    DeclNode * decl = make_node<DeclNode>(Node::Kind::Decl, token);
+    decl->local = local;
+    decl->name  = token.data.symbol;
+    decl->slot  = ERROR_IDX;
+    decl->value = nullptr;
+
+    token = seek_token(++i);
+    if (token.type == Token::Type::Dot) {
+        log->set_snippet(token.snippet());
+        SYNTAXERROR(InvalidAssignment, "cannot declare a property");
+        return ERROR_IDX;
+    }
+
+    // Types aren't checked yet, so annotations are skipped up to the value
+    if (token.type == Token::Type::Colon) {
+        token = seek_token(++i);
+        while (lex->has(i) && token.type != Token::Type::End && token.type != Token::Type::Equal) {
+            if (token.type == Token::Type::Colon) {
+                log->set_snippet(token.snippet());
+                SYNTAXERROR(UnexpectedToken, "unexpected operator '%s', expected assignment or end", lex->lexeme(token).c_str());
+                return ERROR_IDX;
+            }
+            token = seek_token(++i);
         }
-        default: return ERROR_IDX;
     }
 
-    i = parse_expr(i, true, true);
+    // Declarations without a value don't need any expression
+    if (token.type == Token::Type::End) {
+        node = decl;
+        return i;
+    }
+
+    if (token.type != Token::Type::Equal) {
+        log->set_snippet(token.snippet());
+        SYNTAXERROR(UnexpectedToken, "unexpected token '%s', expected assignment or end", lex->lexeme(token).c_str());
+        return ERROR_IDX;
+    }
+
+    i = parse_expr(i + 1, decl->value, can_assign, true, end);
+    if (i == ERROR_IDX) return ERROR_IDX;
+
+    node = decl;
 
     return i;
 }
 
-size_t llama::Analyser::parse_expr(size_t pos, bool can_assign, bool is_decl, Token::Type end) {
+/* -=- Expressions -=- */
+size_t llama::Analyser::parse_expr(size_t pos, Node *& node, bool can_assign, bool is_decl, Token::Type end) {
     INFO("analysing an expression at %zu (can_assign=%s, is_decl=%s, end=Token::%s)", pos, BOOLALPHA(can_assign), BOOLALPHA(is_decl), Token(end).type_str());
 
-    std::vector<Token> out, ops;
+    size_t i = parse_precedence(pos, node, 0, can_assign);
+    if (i == ERROR_IDX) return ERROR_IDX;
 
-    bool has_end    = false;
-    bool has_equal  = false;
-    bool has_type   = false;
-    bool has_arith  = false;
-    bool has_access = false;
-    
-    size_t expr_start = pos;
+    // Checkes for a missing ';'
+    if (!lex->has(i)) {
+        Token token = seek_token(pos);
+        log->set_snippet(token.snippet());
+        SYNTAXERROR(MissingEnd, "missing ';' operator");
+        return ERROR_IDX;
+    }
 
-    // Current token
-    Token token;
+    Token token = seek_token(i);
+    if (token.type == end) return i;
 
-    // For handling different types of tokens
-    auto do_operand = [&](size_t i) {
-        out.push_back(token);
-        if (ops.size() > 0 && ops.back().is_unary()) {
-            out.push_back(ops.back());
-            ops.pop_back();
-        }
+    if (token.type == Token::Type::Colon && is_decl) {
+        log->set_snippet(token.snippet());
+        SYNTAXERROR(InvalidAssignment, "cannot specify a type after assignment");
+        return ERROR_IDX;
+    } else if (token.type == Token::Type::Equal && can_assign) {
+        log->set_snippet(token.snippet());
+        SYNTAXERROR(InvalidAssignment, "only variables and properties can be assigned to");
+        return ERROR_IDX;
+    }
 
-        return i;
-    };
+    return unexpected(token);
+}
 
-    auto do_operator = [&](size_t i) {
-        if (token.type == Token::Type::Dot && !has_equal) {
-            if (is_decl) {
-                log->set_snippet(token.snippet);
-                SYNTAXERROR("cannot declare a property");
-                return ERROR_IDX;
-            }
-            has_access = true;
-        }
+size_t llama::Analyser::parse_precedence(size_t pos, Node *& node, int min_prec, bool can_assign) {
+    size_t i = parse_prefix(pos, node, can_assign);
 
-        // Pop all the remaining operators onto the output stack
-        while (!ops.empty() && ops.back().type != Token::Type::LParen) {
-            auto & op = ops.back();
-            if ((op.precedence() == token.precedence() && token.associativity()) || 
-                token.is_internal() || op.precedence() > token.precedence()) {
-                out.push_back(ops.back());
-                ops.pop_back();
-            } else break;
-        }
+    // Operators keep extending the left operand as long as they bind tighter than the caller's
+    while (i != ERROR_IDX && lex->has(i)) {
+        Token op = seek_token(i);
 
-        if (token.is_internal()) out.push_back(token);
-        else                     ops.push_back(token);
+        // The lexer can't tell '+' after a ')' apart from an unary one, only its position can
+        if (op.type == Token::Type::UnaryPlus)  op.type = Token::Type::Plus;
+        if (op.type == Token::Type::UnaryMinus) op.type = Token::Type::Minus;
 
-        if (token.is_arithmetic() || token.is_logical()) has_arith = true;
+        // Calls bind as tight as property accesses
+        int prec = op.type == Token::Type::CallStart ? Token(Token::Type::Dot).precedence() : op.precedence();
 
-        return i;
-    };
-
-    auto do_rparen = [&](size_t i) {
-        // Handles everything inside the parenthesis
-        while (!ops.empty() && ops.back().type != Token::Type::LParen) {
-            out.push_back(ops.back());
-            ops.pop_back();
-
-            if (ops.empty()) {
-                // TODO: not handling this since it was checked during the refactoring (?)
-                log->set_snippet(token.snippet);
-                SYNTAXERROR("unmatched parenthesis");
-                return ERROR_IDX;
-            }
-        }
+        if (!(op.is_arithmetic() || op.is_logical() || op.is_access() || op.type == Token::Type::CallStart)) break;
+        if (prec < min_prec) break;
 
-        // Pops the remainder onto the output stack
-        if (!ops.empty() && ops.back().type == Token::Type::LParen) {
-            ops.pop_back();
-        }
+        i = parse_infix(i, node, op);
+    }
 
-        return i;
-    };
+    return i;
+}
 
-    auto do_scope = [&](size_t i) {
-        // Pops all the remaining operators onto the output stack
-        while (!ops.empty() && ops.back().type != Token::Type::LParen) {
-            out.push_back(ops.back());
-            ops.pop_back();
-        }
+size_t llama::Analyser::parse_prefix(size_t pos, Node *& node, bool can_assign) {
+    // Running out of tokens is reported by parse_expr() as a missing ';'
+    if (!lex->has(pos)) return pos;
 
-        if (!ops.empty() && ops.back().type == Token::Type::LParen) {
-            log->set_snippet(token.snippet);
-            SYNTAXERROR("unmatched parenthesis");
-            return ERROR_IDX;
+    Token token = seek_token(pos);
+
+    switch (token.type) {
+        case Token::Type::Null:  { node = make_node<Node>(Node::Kind::Null,  token); return pos + 1; }
+        case Token::Type::True:  { node = make_node<Node>(Node::Kind::True,  token); return pos + 1; }
+        case Token::Type::False: { node = make_node<Node>(Node::Kind::False, token); return pos + 1; }
+        case Token::Type::Integer: {
+            IntegerNode * integer = make_node<IntegerNode>(Node::Kind::Integer, token);
+            integer->value = token.data.integer;
+            node = integer;
+            return pos + 1;
         }
+        case Token::Type::Decimal: {
+            DecimalNode * decimal = make_node<DecimalNode>(Node::Kind::Decimal, token);
+            decimal->value = token.data.decimal;
+            node = decimal;
+            return pos + 1;
+        }
+        case Token::Type::String: {
+            // The text is copied, the lexer may drop the source under it before the tree is emitted
+            std::string str = lex->lexeme(token);
+
+            StringNode * string = make_node<StringNode>(Node::Kind::String, token);
+            string->str = arena.copy(str.c_str(), str.size());
+            node = string;
+            return pos + 1;
+        }
+        case Token::Type::Label: {
+            // A label followed by property names and a '=' is the target of an assignment
+            size_t i = pos + 1;
+            while (seek_token(i).type == Token::Type::Dot && seek_token(i + 1).type == Token::Type::Label) i += 2;
+
+            if (seek_token(i).type == Token::Type::Equal) return parse_assign(pos, node, i, can_assign);
+
+            NameNode * name = make_node<NameNode>(Node::Kind::Name, token);
+            name->name = token.data.symbol;
+            name->slot = ERROR_IDX;
+            node = name;
+            return pos + 1;
+        }
+        case Token::Type::LParen: {
+            size_t i = parse_precedence(pos + 1, node, 0, false);
+            if (i == ERROR_IDX) return ERROR_IDX;
 
-        return i;
-    };
+            Token close = seek_token(i);
+            if (close.type == Token::Type::RParen) return i + 1;
+            if (close.type != Token::Type::End && lex->has(i)) return unexpected(close);
 
-    auto specific_check = [&](size_t i, Token token) {
-        switch (token.type) {
-            case Token::Type::Colon: {
-                if (!is_decl) {
-                    log->set_snippet(token.snippet);
-                    SYNTAXERROR("cannot specify a type here");
-                    return ERROR_IDX;
-                } else if (has_equal) {
-                    log->set_snippet(token.snippet);
-                    SYNTAXERROR("cannot specify a type after assignment");
-                    return ERROR_IDX;
-                } else if (has_type) {
-                    log->set_snippet(token.snippet);
-                    SYNTAXERROR("unexpected operator '%s', expected assignment or end", token.lexeme.c_str());
-                    return ERROR_IDX;
-                }
-
-                while (i < lex->tokens.size()) {
-                    Token::Type type = seek_token(i).type;
-                    if (type == Token::Type::End || type == Token::Type::Equal) break;
-                    ++i;
-                }
-                has_type = true;
+            log->set_snippet(token.snippet());
+            SYNTAXERROR(UnmatchedToken, "unmatched parenthesis");
+            return ERROR_IDX;
+        }
+        case Token::Type::Plus:
+        case Token::Type::Minus:
+        case Token::Type::UnaryPlus:
+        case Token::Type::UnaryMinus:
+        case Token::Type::Not: {
+            // Unary operators take a single operand, calls and properties included
+            UnaryNode * unary = make_node<UnaryNode>(Node::Kind::Unary, token);
+
+            size_t i = parse_precedence(pos + 1, unary->operand, Token(Token::Type::Not).precedence(), false);
+            if (i == ERROR_IDX) return ERROR_IDX;
 
-                break;
-            }
-            case Token::Type::Comma: {
-                out.push_back(token);
-                i = do_scope(i);
-                break;
-            }
-            case Token::Type::LParen: {
-                ops.push_back(token);
-                break;
-            }
-            case Token::Type::RParen: {
-                i = do_rparen(i);
-                break;
+            if (token.type == Token::Type::Not) {
+                unary->op = Token::Type::Not;
+            } else if (token.type == Token::Type::Plus || token.type == Token::Type::UnaryPlus) {
+                unary->op = Token::Type::Plus;
+            } else {
+                unary->op = Token::Type::Minus;
             }
-            case Token::Type::Equal: {
-                if (!can_assign) {
-                    log->set_snippet(token.snippet);
-                    SYNTAXERROR("assignment is forbidden at this scope");
-                    return ERROR_IDX;
-                }
 
-                expr_start = i;
+            node = unary;
+            return i;
+        }
+        case Token::Type::End:
+        case Token::Type::RParen:
+        case Token::Type::LBrace:
+        case Token::Type::RBrace: {
+            log->set_snippet(token.snippet());
+            SYNTAXERROR(ExpectedExpression, "expected expression");
+            return ERROR_IDX;
+        }
+        default: {
+            if (!token.is_operand()) return unexpected(token);
 
-                has_equal = true;
+            log->set_snippet(token.snippet());
+            SYNTAXERROR(Internal, "[INTERNAL] unknown token with type '%s' in expression", token.type_str());
+            return ERROR_IDX;
+        }
+    }
+}
 
-                i = do_scope(i);
-                out.push_back(token);
-                break;
-            }
-            default: {
-                log->set_snippet(token.snippet);
-                SYNTAXERROR("unexpected token '%s' in expression", token.lexeme.c_str());
+size_t llama::Analyser::parse_infix(size_t pos, Node *& node, Token op) {
+    switch (op.type) {
+        case Token::Type::Dot: {
+            Token name = seek_token(pos + 1);
+            if (name.type != Token::Type::Label) {
+                log->set_snippet(op.snippet());
+                SYNTAXERROR(UnexpectedToken, "unexpected token '.'");
                 return ERROR_IDX;
             }
+
+            PropertyNode * property = make_node<PropertyNode>(Node::Kind::Property, name);
+            property->object = node;
+            property->name   = name.data.symbol;
+            node = property;
+            return pos + 2;
         }
+        case Token::Type::CallStart: return parse_call(pos, node);
+        default: break;
+    }
 
-        return i;
-    };
+    BinaryNode * binary = make_node<BinaryNode>(Node::Kind::Binary, op);
+    binary->op  = op.type;
+    binary->lhs = node;
 
-    // Iterates over all tokens
-    size_t i = pos;
-    while (i < lex->tokens.size() && !has_end) {
-        token = lex->tokens[i];
-
-        if (token.is_operand()) {
-            i = do_operand(i);
-        } else if (token.is_expr() || token.is_internal()) {
-            i = do_operator(i);
-        } else if (token.type == end) {
-            if (expr_start > pos && expr_start + 1 == i) {
-                log->set_snippet(token.snippet);
-                SYNTAXERROR("expected expression");
-                return ERROR_IDX;
-            }
+    // Right associative operators let the right operand hold another one of themselves
+    int    prec = op.precedence();
+    size_t i    = parse_precedence(pos + 1, binary->rhs, op.associativity() ? prec : prec + 1, false);
+    if (i == ERROR_IDX) return ERROR_IDX;
 
-            has_end = true;
-            break;
-        } else {
-            i = specific_check(i, token);
-        }
+    node = binary;
 
-        if (i == ERROR_IDX) return ERROR_IDX;
+    return i;
+}
 
-        ++i;
-    }
+size_t llama::Analyser::parse_call(size_t pos, Node *& node) {
+    // The lexer wraps the arguments as CallStart ( ... ) CallEnd
+    CallNode * call = make_node<CallNode>(Node::Kind::Call, seek_token(pos));
+    call->callee = node;
 
-    // Checkes for a missing ';'
-    if (!has_end) {
-        token = seek_token(pos);
-        log->set_snippet(token.snippet);
-        SYNTAXERROR("missing ';' operator");
-        return ERROR_IDX;
-    }
+    size_t base = pending.size();
+    size_t i    = pos + 2;
 
-    // Checkes for a unmatched parenthesis
-    while (!ops.empty()) {
-        if (ops.back().type == Token::Type::LParen) {
-            token = ops.back();
-            log->set_snippet(token.snippet);
-            SYNTAXERROR("unmatched parenthesis");
+    while (seek_token(i).type != Token::Type::RParen) {
+        Node * arg = nullptr;
+        i = parse_precedence(i, arg, 0, false);
+        if (i == ERROR_IDX) {
+            pending.resize(base);
             return ERROR_IDX;
         }
-        out.push_back(ops.back());
-        ops.pop_back();
+        pending.push_back(arg);
+
+        Token token = seek_token(i);
+        if (token.type == Token::Type::Comma) {
+            ++i;
+        } else if (token.type != Token::Type::RParen) {
+            pending.resize(base);
+            return unexpected(token);
+        }
     }
 
-    // Outputs the bytecode equivalent
-    //printf("-- QUICK TOKEN DUMP --\n");
-    //for (auto & t : out) printf("'%s': %s\n", t.lexeme.c_str(), t.type_str());
+    call->args = make_list(base);
+    node = call;
 
-    Token last;
-    
-    bool is_assign = has_equal;
-    bool is_global = true;
-    bool is_call   = false;
-
-    std::list<std::pair<size_t, std::string>> labels;
-
-    std::stack<size_t> args_count;
-    std::stack<bool>   no_comma;
-    size_t             pop_count = 0;
-    size_t             eq_count  = 0;
-
-    // For transpiling tokens to bytecode
-    auto transpile = [&](size_t i, Token & token) {
-        if (token.is_expr() && !token.is_access()) {
-            --pop_count;
-            is_global = true;
-        } else {
-            ++pop_count;
-        }
+    return i + 2;
+}
 
-        switch (token.type) {
-            case Token::Type::Null: {
-                ir->_pushnull();
-                if (!args_count.empty() && !no_comma.empty()) no_comma.top() = true;
-                break;
-            }
-            case Token::Type::True: {
-                ir->_pushtrue();
-                if (!args_count.empty() && !no_comma.empty()) no_comma.top() = true;
-                break;
-            }
-            case Token::Type::False: {
-                ir->_pushfalse();
-                if (!args_count.empty() && !no_comma.empty()) no_comma.top() = true;
-                break;
-            }
-            case Token::Type::Integer: {
-                ir->_pushint(std::stoi(token.lexeme.c_str()));
-                if (!args_count.empty() && !no_comma.empty()) no_comma.top() = true;
-                break;
-            }
-            case Token::Type::Decimal: {
-                ir->_pushfloat(std::stod(token.lexeme.c_str()));
-                if (!args_count.empty() && !no_comma.empty()) no_comma.top() = true;
-                break;
-            }
-            case Token::Type::String: {
-                ir->_pushstring(token.lexeme.c_str());
-                if (!args_count.empty() && !no_comma.empty()) no_comma.top() = true;
-                break;
-            }
-            case Token::Type::Label: {
-                if (is_assign){
-                    ir->_refglobal(token.lexeme);
-                    --pop_count;
-                } else {
-                    ir->_getglobal(token.lexeme);
-                }
-
-                if (!is_global) labels.push_back(std::make_pair(ir->size() - 1, token.lexeme));
-                is_global = false;
-
-                if (!args_count.empty() && !no_comma.empty()) no_comma.top() = true;
-                break;
-            }
-            case Token::Type::Equal: {
-                labels.clear();
-                eq_count  = pop_count;
-                is_global = true;
-                is_assign = false;
-                break;
-            }
-            case Token::Type::Plus: {
-                ir->_add();
-                break;
-            }
-            case Token::Type::Minus: {
-                ir->_sub();
-                break;
-            }
-            case Token::Type::Multiply: {
-                ir->_mul();
-                break;
-            }
-            case Token::Type::Divide: {
-                ir->_div();
-                break;
-            }
-            case Token::Type::Modulo: {
-                ir->_mod();
-                break;
-            }
-            case Token::Type::Power: {
-                ir->_pow();
-                break;
-            }
-            case Token::Type::Dot: {
-                if (labels.empty()) {
-                    log->set_snippet(token.snippet);
-                    SYNTAXERROR("unexpected token '.'");
-                    return ERROR_IDX;
-                }
-
-                // I don't know what the fuck I've done here but it works so
-                if (is_assign) ir->_refproperty(labels.front().second);
-                else           ir->_getproperty(labels.front().second, -1);
-                
-                ir->set(ir->at(ir->size() - 1), labels.front().first);
-                //INFO("instruction changed at %zu to %s", labels.back().first, ir->at(labels.front().first).dump().c_str());
-                ir->pop();
-
-                labels.pop_front();
-                break;
-            }
-            case Token::Type::CallStart: {
-                args_count.push(0);
-                no_comma.push(false);
-                is_call = true;
-                break;
-            }
-            case Token::Type::CallEnd: {
-                ir->_call(args_count.top() + no_comma.top());
-                args_count.pop();
-                no_comma.pop();
-                if (args_count.empty()) is_call = false;
-                break;
-            }
-            case Token::Type::Not: {
-                ir->_not();
-                break;
-            }
-            case Token::Type::And: {
-                ir->_and();
-                break;
-            }
-            case Token::Type::Or: {
-                ir->_or();
-                break;
-            }
-            case Token::Type::Equals: {
-                ir->_eq();
-                break;
-            }
-            case Token::Type::Lesser: {
-                ir->_lt();
-                break;
-            }
-            case Token::Type::LeEquals: {
-                ir->_le();
-                break;
-            }
-            case Token::Type::Greater: {
-                ir->_gt();
-                break;
-            }
-            case Token::Type::GrEquals: {
-                ir->_ge();
-                break;
-            }
-            case Token::Type::NotEquals: {
-                ir->_ne();
-                break;
-            }
-            case Token::Type::UnaryPlus: {
-                ir->_promote();
-                break;
-            }
-            case Token::Type::UnaryMinus: {
-                ir->_negate();
-                break;
-            }
-            case Token::Type::Comma: {
-                if (args_count.empty()) {
-                    log->set_snippet(token.snippet);
-                    SYNTAXERROR("comma out of array, class or function");
-                    return ERROR_IDX;
-                }
-                ++args_count.top();
-                no_comma.top() = false;
-                break;
-            }
-            default: {
-                log->set_snippet(token.snippet);
-                SYNTAXERROR("[INTERNAL] unknown token with type '%s' in expression", token.type_str());
-                return ERROR_IDX;
-            }
-        }
+size_t llama::Analyser::parse_assign(size_t pos, Node *& node, size_t equal, bool can_assign) {
+    Token token = seek_token(pos);
 
-        //printf("%zu = '%s': %s (values=(%zu, %zu/%s))\n", i, token.lexeme.c_str(), token.type_str(), labels.size(), 
-        //        labels.empty() ? 0 : labels.back().first, labels.empty() ? 0 : labels.back().second.c_str());
+    if (!can_assign) {
+        log->set_snippet(seek_token(equal).snippet());
+        SYNTAXERROR(InvalidAssignment, "assignment is forbidden at this scope");
+        return ERROR_IDX;
+    }
+
+    if (equal == pos + 1) {
+        AssignNode * assign = make_node<AssignNode>(Node::Kind::Assign, token);
+        assign->name = token.data.symbol;
+        assign->slot = ERROR_IDX;
 
+        size_t i = parse_precedence(equal + 1, assign->value, 0, true);
+        if (i != ERROR_IDX) node = assign;
         return i;
-    };
-
-    // For handling different types of tokens
-    for (size_t i = 0; i < out.size(); ++i) {
-        if (token.is_operand()) {
-            ++pop_count;
-        } else if (token.is_expr() && !token.is_special()) {
-            --pop_count;
-        }
+    }
 
-        i = transpile(i, out[i]);
-        if (i == ERROR_IDX) return ERROR_IDX;
+    SetPropertyNode * set = make_node<SetPropertyNode>(Node::Kind::SetProperty, token);
+    set->root      = token.data.symbol;
+    set->path_size = (equal - pos - 1) / 2;
+    set->path      = arena.make_array<Symbol>(set->path_size);
+    for (size_t j = 0; j < set->path_size; ++j) set->path[j] = seek_token(pos + 2 + j * 2).data.symbol;
 
-        last = out[i];
-    }
+    size_t i = parse_precedence(equal + 1, set->value, 0, true);
+    if (i != ERROR_IDX) node = set;
 
-    if (has_equal) {
-        ir->_refset(-(int)(eq_count + 1));
-        --pop_count;
-    }
+    return i;
+}
 
-    --pop_count;
-    if (pop_count >= 1) {
-        //ir->_popn(pop_count);
-    } else {
-        //ir->_pop();
+size_t llama::Analyser::unexpected(Token token) {
+    log->set_snippet(token.snippet());
+
+    switch (token.type) {
+        case Token::Type::Colon: SYNTAXERROR(UnexpectedToken,   "cannot specify a type here");            break;
+        case Token::Type::Comma: SYNTAXERROR(UnexpectedToken,   "comma out of array, class or function"); break;
+        case Token::Type::Equal: SYNTAXERROR(InvalidAssignment, "assignment is forbidden at this scope"); break;
+        default:                 SYNTAXERROR(UnexpectedToken, "unexpected token '%s' in expression", lex->lexeme(token).c_str()); break;
     }
 
-    // TODO: only make it pop the values if there is an ; operator, else printing the remainder like lua
+    return ERROR_IDX;
+}
 
-    return i;
+/* -=- Nodes -=- */
+llama::NodeList llama::Analyser::make_list(size_t base) {
+    // Lists only get their final size once parsed, meanwhile their items wait in pending
+    NodeList list;
+    list.size  = pending.size() - base;
+    list.items = arena.make_array<Node *>(list.size);
+    for (size_t i = 0; i < list.size; ++i) list.items[i] = pending[base + i];
+
+    pending.resize(base);
+
+    return list;
 }
 
 /* -=- Token management -=- */
 llama::Token llama::Analyser::seek_token(size_t pos) {
     // Does the exact same as the seek() function but for tokens
-    if (pos >= lex->tokens.size()) return Token(Token::Type::Unknown);
-    return lex->tokens[pos];
+    if (!lex->has(pos)) return Token(Token::Type::Unknown);
+    return lex->at(pos);
 }
 
 /* -=- Formatters -=- */
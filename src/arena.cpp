@@ -0,0 +1,96 @@
+/* -=============
+     Includes
+   =============- */
+
+#include <arena.h>
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+/* -================
+     Arena class
+   ================- */
+
+/* -=- (Con/des)tructors -=- */
+llama::Arena::Arena(size_t m_chunk_size) {
+    chunks     = nullptr;
+    cur        = nullptr;
+    end        = nullptr;
+    chunk_size = m_chunk_size;
+    used       = 0;
+    reserved   = 0;
+}
+
+llama::Arena::~Arena() {
+    while (chunks != nullptr) {
+        Chunk * next = chunks->next;
+        free(chunks);
+        chunks = next;
+    }
+}
+
+/* -=- Allocation -=- */
+void * llama::Arena::grow(size_t size) {
+    // Blocks too big for a chunk get one of their own, slid behind the current chunk so whatever
+    // is left of it still gets used
+    bool   own   = size > chunk_size / 4;
+    size_t bytes = HEADER + (own ? size : chunk_size);
+
+    Chunk * chunk = (Chunk *)(malloc(bytes));
+    if (chunk == nullptr) throw std::bad_alloc();
+    chunk->size = bytes;
+    reserved   += bytes;
+    used       += size;
+
+    char * data = (char *)(chunk) + HEADER;
+
+    if (own && chunks != nullptr) {
+        chunk->next  = chunks->next;
+        chunks->next = chunk;
+        return data;
+    }
+
+    chunk->next = chunks;
+    chunks      = chunk;
+    cur         = data + size;
+    end         = data + bytes - HEADER;
+
+    return data;
+}
+
+char * llama::Arena::copy(const char * str, size_t length) {
+    char * ptr = (char *)(alloc(length + 1));
+    memcpy(ptr, str, length);
+    ptr[length] = '\0';
+    return ptr;
+}
+
+void llama::Arena::reset() {
+    if (chunks == nullptr) return;
+
+    // Only the chunk being carved is kept, it's the one most likely to fit the next round
+    Chunk * keep = chunks;
+    for (Chunk * chunk = keep->next; chunk != nullptr;) {
+        Chunk * next = chunk->next;
+        reserved -= chunk->size;
+        free(chunk);
+        chunk = next;
+    }
+
+    keep->next = nullptr;
+    chunks     = keep;
+    cur        = (char *)(keep) + HEADER;
+    end        = (char *)(keep) + keep->size;
+    used       = 0;
+}
+
+/* -=- (S/g)etters -=- */
+size_t llama::Arena::get_used() {
+    return used;
+}
+
+size_t llama::Arena::get_reserved() {
+    return reserved;
+}
@@ -0,0 +1,274 @@
+/* -=============
+     Includes
+   =============- */
+
+#include <codegen.h>
+#include <ast.h>
+#include <ir.h>
+#include <module.h>
+#include <error.h>
+
+#include <cstddef>
+#include <string>
+
+/* -==================
+     CodeGen class
+   ==================- */
+
+/* -=- (Con/des)tructors -=- */
+llama::CodeGen::CodeGen() {
+    mod = nullptr;
+    log = nullptr;
+    ir  = nullptr;
+}
+
+/* -=- Base functions -=- */
+void llama::CodeGen::setup(Module * m_mod, Logger * m_log, IRBuilder * m_ir) {
+    mod = m_mod;
+    log = m_log;
+    ir  = m_ir;
+}
+
+llama::Status llama::CodeGen::emit(Node * node) {
+    switch (node->kind) {
+        case Node::Kind::ExprStmt: {
+            // Expression statements discard their value
+            if (emit_expr(node->as<ExprStmtNode>()->expr) != Ok) return Failure;
+            ir->_pop();
+            return Ok;
+        }
+        case Node::Kind::Decl: {
+            DeclNode * decl = node->as<DeclNode>();
+
+            if (decl->local) ir->_newlocal(decl->slot);
+            else             ir->_newglobal(decl->name);
+
+            if (decl->value == nullptr) return Ok;
+            if (emit_expr(decl->value) != Ok) return Failure;
+
+            emit_set(decl->name, decl->slot);
+            ir->_pop();
+            return Ok;
+        }
+        case Node::Kind::Block: return emit_block(node->as<BlockNode>());
+        case Node::Kind::If: {
+            IfNode * stmt = node->as<IfNode>();
+            if (emit_expr(stmt->cond) != Ok) return Failure;
+
+            ir->push_if();
+                if (emit_block(stmt->then) != Ok) return Failure;
+
+                if (stmt->otherwise != nullptr) {
+                    ir->push_else();
+                    if (emit_block(stmt->otherwise) != Ok) return Failure;
+                }
+            ir->end_block();
+            return Ok;
+        }
+        case Node::Kind::While: {
+            WhileNode * stmt = node->as<WhileNode>();
+            ir->push_loop();
+                if (emit_expr(stmt->cond) != Ok) return Failure;
+
+                ir->push_if();
+                    if (emit_block(stmt->body) != Ok) return Failure;
+                    ir->_repeat();
+                ir->end_block();
+
+                ir->_break();
+            ir->end_block();
+            return Ok;
+        }
+        case Node::Kind::Loop: {
+            ir->push_loop();
+                if (emit_block(node->as<LoopNode>()->body) != Ok) return Failure;
+            ir->end_block();
+            return Ok;
+        }
+        case Node::Kind::Fn:     return emit_fn(node->as<FnNode>());
+        case Node::Kind::Repeat: { ir->_repeat(); return Ok; }
+        case Node::Kind::Break:  { ir->_break();  return Ok; }
+        case Node::Kind::Return: {
+            ReturnNode * stmt = node->as<ReturnNode>();
+            if (stmt->value == nullptr) {
+                ir->_returnv();
+                return Ok;
+            }
+
+            if (emit_expr(stmt->value) != Ok) return Failure;
+            ir->_return();
+            return Ok;
+        }
+        default: {
+            log->set_snippet(node->snippet());
+            SYNTAXERROR(Internal, "[INTERNAL] expression node %d used as a statement", (int)(node->kind));
+            return Failure;
+        }
+    }
+}
+
+llama::Status llama::CodeGen::emit_expr(Node * node) {
+    switch (node->kind) {
+        case Node::Kind::Null:    { ir->_pushnull();                                 return Ok; }
+        case Node::Kind::True:    { ir->_pushtrue();                                 return Ok; }
+        case Node::Kind::False:   { ir->_pushfalse();                                return Ok; }
+        case Node::Kind::Integer: { ir->_pushint(node->as<IntegerNode>()->value);    return Ok; }
+        case Node::Kind::Decimal: { ir->_pushfloat(node->as<DecimalNode>()->value);  return Ok; }
+        case Node::Kind::String:  { ir->_pushstring(node->as<StringNode>()->str);    return Ok; }
+        case Node::Kind::Name: {
+            NameNode * name = node->as<NameNode>();
+            emit_get(name->name, name->slot);
+            return Ok;
+        }
+        case Node::Kind::Property: {
+            PropertyNode * property = node->as<PropertyNode>();
+            if (emit_expr(property->object) != Ok) return Failure;
+            ir->_getproperty(property->name, -1);
+            return Ok;
+        }
+        case Node::Kind::Unary: {
+            UnaryNode * unary = node->as<UnaryNode>();
+            if (emit_expr(unary->operand) != Ok) return Failure;
+
+            if (unary->op == Token::Type::Not)       ir->_not();
+            else if (unary->op == Token::Type::Plus) ir->_promote();
+            else                                     ir->_negate();
+            return Ok;
+        }
+        case Node::Kind::Binary: {
+            BinaryNode * binary = node->as<BinaryNode>();
+            if (emit_expr(binary->lhs) != Ok || emit_expr(binary->rhs) != Ok) return Failure;
+
+            switch (binary->op) {
+                case Token::Type::Plus:      { ir->_add(); break; }
+                case Token::Type::Minus:     { ir->_sub(); break; }
+                case Token::Type::Multiply:  { ir->_mul(); break; }
+                case Token::Type::Divide:    { ir->_div(); break; }
+                case Token::Type::Modulo:    { ir->_mod(); break; }
+                case Token::Type::Power:     { ir->_pow(); break; }
+                case Token::Type::And:       { ir->_and(); break; }
+                case Token::Type::Or:        { ir->_or();  break; }
+                case Token::Type::Equals:    { ir->_eq();  break; }
+                case Token::Type::NotEquals: { ir->_ne();  break; }
+                case Token::Type::Lesser:    { ir->_lt();  break; }
+                case Token::Type::LeEquals:  { ir->_le();  break; }
+                case Token::Type::Greater:   { ir->_gt();  break; }
+                case Token::Type::GrEquals:  { ir->_ge();  break; }
+                default: {
+                    log->set_snippet(node->snippet());
+                    SYNTAXERROR(Internal, "[INTERNAL] unknown token with type '%s' in expression", Token(binary->op).type_str());
+                    return Failure;
+                }
+            }
+            return Ok;
+        }
+        case Node::Kind::Call: {
+            CallNode * call = node->as<CallNode>();
+            if (emit_expr(call->callee) != Ok) return Failure;
+            for (size_t i = 0; i < call->args.size; ++i) {
+                if (emit_expr(call->args.items[i]) != Ok) return Failure;
+            }
+            ir->_call(call->args.size);
+            return Ok;
+        }
+        case Node::Kind::Assign: {
+            // Plain variables are stored straight into their slot once the value is known
+            AssignNode * assign = node->as<AssignNode>();
+            if (emit_expr(assign->value) != Ok) return Failure;
+            emit_set(assign->name, assign->slot);
+            return Ok;
+        }
+        case Node::Kind::SetProperty: {
+            // Properties are set through references, stacked below the value
+            SetPropertyNode * set = node->as<SetPropertyNode>();
+
+            ir->_refglobal(set->root);
+            for (size_t i = 0; i < set->path_size; ++i) ir->_refproperty(set->path[i]);
+
+            if (emit_expr(set->value) != Ok) return Failure;
+            ir->_refset(-(int)(set->path_size + 2));
+            return Ok;
+        }
+        default: {
+            log->set_snippet(node->snippet());
+            SYNTAXERROR(Internal, "[INTERNAL] statement node %d used as an expression", (int)(node->kind));
+            return Failure;
+        }
+    }
+}
+
+llama::Status llama::CodeGen::emit_block(BlockNode * node) {
+    if (node->block) ir->push_block();
+    for (size_t i = 0; i < node->body.size; ++i) {
+        if (emit(node->body.items[i]) != Ok) return Failure;
+    }
+    if (node->block) ir->end_block();
+
+    return Ok;
+}
+
+llama::Status llama::CodeGen::emit_fn(FnNode * node) {
+    SymbolPool * symbols = mod->get_symbols();
+
+    FunctionEntry func;
+    func.set_line(node->line);
+
+    if (node->name != ERROR_IDX_BIN) {
+        if (mod->get_functions()->has(node->name)) {
+            log->set_snippet(node->snippet());
+            SYNTAXERROR(AlreadyDeclared, "the function %s already exists", symbols->name(node->name).c_str());
+            return Failure;
+        }
+
+        func.set_name(symbols->name(node->name), node->name);
+    }
+
+    for (size_t i = 0; i < node->argc; ++i) {
+        FunctionEntry::Argument arg;
+        arg.field    = symbols->name(node->args[i].symbol);
+        arg.symbol   = node->args[i].symbol;
+        arg.optional = false;
+        if (node->args[i].type != nullptr) arg.type = node->args[i].type;
+
+        func.push_arg(arg);
+    }
+
+    // The body goes to a builder of its own, nested functions get added before their parent
+    IRBuilder * prev_ir = ir;
+    IRBuilder   fn_ir   = IRBuilder();
+
+    fn_ir.set_module(mod);
+
+    ir = &fn_ir;
+    Status status = emit_block(node->body);
+    if (status == Ok) {
+        ir->_returnv();
+        ir->build(func.get_data());
+        func.set_locals(node->locals);
+    }
+    ir = prev_ir;
+
+    if (status != Ok) return Failure;
+
+    size_t func_idx = mod->get_functions()->add(func);
+
+    if (node->name != ERROR_IDX_BIN) {
+        ir->_newglobal(node->name);
+        ir->_pushfunc(func_idx);
+        ir->_setglobal_slot(node->name);
+        ir->_pop();
+    }
+
+    return Ok;
+}
+
+/* -=- Variables -=- */
+void llama::CodeGen::emit_get(Symbol name, size_t slot) {
+    if (slot != ERROR_IDX) ir->_getlocal(slot);
+    else                   ir->_getglobal_slot(name);
+}
+
+void llama::CodeGen::emit_set(Symbol name, size_t slot) {
+    if (slot != ERROR_IDX) ir->_setlocal(slot);
+    else                   ir->_setglobal_slot(name);
+}
@@ -3,12 +3,72 @@
    =============- */
 
 #include <error.h>
+#include <log_sink.h>
 
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
 #include <cstdarg>
+#include <cstring>
 #include <string>
+#include <vector>
+#include <algorithm>
+
+/* -==============
+     Internals
+   ==============- */
+
+namespace llama {
+    // What a conversion pulls out of the arguments, integers are kept in 64 bits whatever their size
+    enum class ArgType {
+        None, 
+        Int, 
+        Long, 
+        LongLong, 
+        Size, 
+        Max, 
+        Ptrdiff, 
+        Double, 
+        String, 
+        Pointer, 
+    };
+
+    // Reads the conversion right after a '%' ('*' widths aren't supported), returning its last character
+    static const char * read_spec(const char * c, ArgType & type) {
+        while (* c != '\0' && strchr("-+ #0", * c) != nullptr) ++c;
+        while (* c >= '0' && * c <= '9') ++c;
+        if (* c == '.') {
+            ++c;
+            while (* c >= '0' && * c <= '9') ++c;
+        }
+
+        ArgType size = ArgType::Int;
+        while (* c != '\0' && strchr("hlzjtL", * c) != nullptr) {
+            switch (* c) {
+                case 'l': size = size == ArgType::Long ? ArgType::LongLong : ArgType::Long; break;
+                case 'z': size = ArgType::Size;    break;
+                case 'j': size = ArgType::Max;     break;
+                case 't': size = ArgType::Ptrdiff; break;
+                default:  break;
+            }
+            ++c;
+        }
+
+        switch (* c) {
+            case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c': type = size;              break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': type = ArgType::Double; break;
+            case 's': type = ArgType::String;  break;
+            case 'p': type = ArgType::Pointer; break;
+            default:  type = ArgType::None;    break;
+        }
+
+        return c;
+    }
+
+    static bool is_unsigned(char conv) {
+        return conv == 'u' || conv == 'x' || conv == 'X' || conv == 'o';
+    }
+}
 
 /* -=====================
      LogSnippet class
@@ -16,51 +76,62 @@
 
 /* -=- (Con/des)tructors -=- */
 llama::LogSnippet::LogSnippet() {
-    start   = 0;
-    end     = 0;
-    line    = 0;
-    collumn = 0;
-}
-
-llama::LogSnippet::LogSnippet(std::string str, size_t pos) {
-    // I don't even know what I have written here but basically this just obtains the
-    // line and collumn based on the index of the character in a string
-    start   = pos;
-    end     = str.length();
-    line    = 1;
-    collumn = 1;
-
-    size_t i = 0;
-    while (i < str.length()) {
-        if (i < start) {
-            if (str[i] == '\n') {
-                ++line;
-                collumn = 1;
-                start   = i;
-            } else {
-                ++collumn;
-            }
-        } else if (str[i] == '\n') {
-            end = i;
-            break;
-        }
-        ++i;
-    }
+    start  = ERROR_IDX;
+    length = 0;
+}
 
-    if (i >= str.length()) {
-        end     = str.length();
-        collumn = 0;
-    }
+llama::LogSnippet::LogSnippet(size_t pos, size_t len) {
+    start  = pos;
+    length = len;
 }
 
 llama::LogSnippet::~LogSnippet() {}
 
+/* -====================
+     LineIndex class
+   ====================- */
+
+/* -=- Base functions -=- */
+void llama::LineIndex::build(const std::string & str) {
+    starts.clear();
+    starts.push_back(0);
+
+    extend(str.data(), str.length(), 0);
+}
+
+void llama::LineIndex::extend(const char * data, size_t len, size_t offset) {
+    // Adds the lines starting in a piece of the source that begins at offset
+    const char * end = data + len;
+    for (const char * c = data; (c = (const char *)(memchr(c, '\n', end - c))) != nullptr; ++c) {
+        starts.push_back(offset + (c - data) + 1);
+    }
+}
+
+size_t llama::LineIndex::line(size_t pos) const {
+    // Lines are 1-indexed, so the amount of line starts up to pos is the line itself
+    return std::upper_bound(starts.begin(), starts.end(), pos) - starts.begin();
+}
+
+size_t llama::LineIndex::collumn(size_t pos) const {
+    size_t ln = line(pos);
+    if (ln == 0) return 0;
+    return pos - starts[ln - 1] + 1;
+}
+
 /* -=================
      Logger class
    =================- */
 
 /* -=- (Con/des)tructors -=- */
 llama::Logger::Logger() {
+    level    = (Type)(LLAMA_LOG_LEVEL);
+    quiet    = false;
+    exit_fn  = nullptr;
+    panic_fn = nullptr;
+    log_fn   = nullptr;
+    sink     = nullptr;
+
+    clear();
     reset();
 }
 
@@ -69,13 +140,22 @@ llama::Logger::~Logger() {}
 /* -=- Base functions -=- */
 void llama::Logger::reset() {
     source   = nullptr;
+    lines    = nullptr;
+    snippet  = LogSnippet();
     __d_file = nullptr;
     __d_func = nullptr;
     __d_line = 0;
-
-    err = "unknown log information";
+    code     = ErrorCode::None;
 
     recoverable = false;
+    muted       = false;
+    errored     = false;
+}
+
+void llama::Logger::clear() {
+    ring_start   = 0;
+    ring_size    = 0;
+    ring_dropped = 0;
 }
 
 void llama::Logger::set_source(const char * file) {
@@ -86,61 +166,344 @@ void llama::Logger::set_snippet(LogSnippet m_snippet) {
     snippet = m_snippet;
 }
 
+void llama::Logger::set_lines(const LineIndex * m_lines) {
+    lines = m_lines;
+}
+
 void llama::Logger::set_debug(const char * file, int line, const char * function) {
     __d_file = file;
     __d_func = function;
     __d_line = line;
 }
 
+void llama::Logger::set_code(ErrorCode m_code) {
+    code = m_code;
+}
+
 void llama::Logger::set_recoverable() {
     recoverable = true;
 }
 
+void llama::Logger::set_muted() {
+    muted = true;
+}
+
+void llama::Logger::set_quiet() {
+    quiet = true;
+}
+
+void llama::Logger::set_level(Type m_level) {
+    // Errors can't be turned off, they still have to stop whatever is being done
+    level = m_level > Type::SyntaxError ? Type::SyntaxError : m_level;
+}
+
+void llama::Logger::set_handlers(ExitFn m_exit_fn, PanicFn m_panic_fn, LogFn m_log_fn) {
+    exit_fn  = m_exit_fn;
+    panic_fn = m_panic_fn;
+    log_fn   = m_log_fn;
+}
+
+void llama::Logger::set_sink(LogSink * m_sink) {
+    sink = m_sink;
+}
+
 void llama::Logger::log(Type type, const char * fmt, ...) {
-    err.clear();
+    // Compiling stops at the first error, the ones raised while unwinding are only echoes of it
+    if (type == Type::SyntaxError && errored) return;
 
-    va_list args1;
-    va_start(args1, fmt);
-    size_t size = vsnprintf(nullptr, 0, fmt, args1) + 1;
-    va_end(args1);
+    if (type >= Type::SyntaxError) errored = true;
+    if (!enabled(type)) return;
 
-    err.resize(size);
+    // Traces aren't kept, they would push the errors out of the ring
+    Diagnostic   trace;
+    Diagnostic * diag = &trace;
+    if (type != Type::Info) {
+        if (ring_size == LLAMA_LOG_RING) {
+            ring_start = (ring_start + 1) % LLAMA_LOG_RING;
+            ++ring_dropped;
+        } else {
+            ++ring_size;
+        }
+        diag = &ring[(ring_start + ring_size - 1) % LLAMA_LOG_RING];
+    }
 
-    va_list args2;
-    va_start(args2, fmt);
-    vsnprintf(&err[0], err.size(), fmt, args2);
-    va_end(args2);
+    va_list args;
+    va_start(args, fmt);
+    capture(* diag, type, fmt, args);
+    va_end(args);
 
-    FILE * f = (type == Type::Info ? stdout : stderr);
+    if (!quiet && sink != nullptr) sink->push(* diag);
+    else if (!quiet)               print(* diag, log_fn);
 
-    if (source != nullptr) fprintf(f, "%s:", source);
+    // A panic means the runtime itself is broken, the host only gets it back when it asked to recover
+    if (type == Type::Panic && !recoverable) {
+        if (sink != nullptr) sink->flush();
+        if (panic_fn != nullptr) panic_fn();
+        abort();
+    }
 
-    if (snippet.line > 0) {
-        fprintf(f, "%zu:", snippet.line);
-        if (snippet.collumn > 0) {
-            fprintf(f, "%zu: ", snippet.collumn);
-        } else fputc(' ', f);
-    } else if (source != nullptr) fputc(' ', f);
+    if (type >= Type::SyntaxError && !recoverable) {
+        if (sink != nullptr) sink->flush();
+        if (exit_fn != nullptr) exit_fn();
+        exit(-1);
+    }
+}
 
-    const char * error = err.c_str();
+void llama::Logger::capture(Diagnostic & diag, Type type, const char * fmt, va_list args) {
+    diag.type    = type;
+    diag.code    = code;
+    diag.snippet = snippet;
+    diag.fmt     = fmt;
+    diag.d_file  = __d_file;
+    diag.d_func  = __d_func;
+    diag.d_line  = __d_line;
 
-    switch (type) {
-        case Type::Info:         { fprintf(f, "info: %s\n", error);          break; }
-        case Type::Warning:      { fprintf(f, "warning: %s\n", error);       break; }
-        case Type::SyntaxError:  { fprintf(f, "syntax error: %s\n", error);  break; }
-        case Type::RuntimeError: { fprintf(f, "runtime error: %s\n", error); break; }
-        case Type::TypeError:    { fprintf(f, "type error: %s\n", error);    break; }
-        case Type::Panic:        { fprintf(f, "PANIC! %s\n", error);         break; }
+    // Sources only last as long as the lexer reading them, so the position is resolved right away
+    diag.line    = 0;
+    diag.collumn = 0;
+    if (lines != nullptr && snippet.start != ERROR_IDX) {
+        diag.line    = lines->line(snippet.start);
+        diag.collumn = lines->collumn(snippet.start);
     }
 
+    size_t source_len = source != nullptr ? strlen(source) : 0;
+    if (source_len >= sizeof(diag.source)) source_len = sizeof(diag.source) - 1;
+
+    if (source_len > 0) memcpy(diag.source, source, source_len);
+    diag.source[source_len] = '\0';
+
+    // Arguments are packed in the order the format reads them, 8 bytes each and strings as they are
+    size_t pos = 0;
+    for (const char * c = fmt; * c != '\0'; ++c) {
+        if (* c != '%') continue;
+
+        ArgType arg;
+        c = read_spec(c + 1, arg);
+        if (* c == '\0') break;
+
+        uint64_t value = 0;
+        switch (arg) {
+            case ArgType::None:     continue;
+            case ArgType::Int:      { value = (uint64_t)(va_arg(args, int));        break; }
+            case ArgType::Long:     { value = (uint64_t)(va_arg(args, long));       break; }
+            case ArgType::LongLong: { value = (uint64_t)(va_arg(args, long long));  break; }
+            case ArgType::Size:     { value = (uint64_t)(va_arg(args, size_t));     break; }
+            case ArgType::Max:      { value = (uint64_t)(va_arg(args, intmax_t));   break; }
+            case ArgType::Ptrdiff:  { value = (uint64_t)(va_arg(args, ptrdiff_t));  break; }
+            case ArgType::Pointer:  { value = (uint64_t)(uintptr_t)(va_arg(args, void *)); break; }
+            case ArgType::Double: {
+                double d = va_arg(args, double);
+                memcpy(&value, &d, sizeof(d));
+                break;
+            }
+            case ArgType::String: {
+                const char * str = va_arg(args, const char *);
+                if (str == nullptr) str = "(null)";
+
+                // Cut strings still end in a NUL, the arguments after them are lost
+                size_t len = strlen(str);
+                if (pos >= sizeof(diag.args)) break;
+                if (len > sizeof(diag.args) - pos - 1) len = sizeof(diag.args) - pos - 1;
+
+                memcpy(diag.args + pos, str, len);
+                diag.args[pos + len] = '\0';
+                pos += len + 1;
+                continue;
+            }
+        }
+
+        if (pos + sizeof(value) > sizeof(diag.args)) {
+            pos = sizeof(diag.args);
+            continue;
+        }
+
+        memcpy(diag.args + pos, &value, sizeof(value));
+        pos += sizeof(value);
+    }
+
+    diag.args_size = pos;
+}
+
+void llama::Logger::print(const Diagnostic & diag, LogFn log_fn) {
+    char line[LLAMA_LOG_LINE];
+    size_t len = diag.format(line, sizeof(line));
+
+    // Hooks get the line without its newline
+    if (log_fn != nullptr) {
+        line[(len < sizeof(line) ? len : sizeof(line) - 1) - 1] = '\0';
+        log_fn(diag.type, line);
+        return;
+    }
+
+    FILE * f = (diag.type == Type::Info ? stdout : stderr);
+    fputs(line, f);
+
 #ifdef LLAMA_DEBUG
-    if (__d_file != nullptr && __d_line > 0 && __d_func != nullptr) {
-        fprintf(f, "\t- from %s:%d\n\t- in %s\n", __d_file, __d_line, __d_func);
+    if (diag.d_file != nullptr && diag.d_line > 0 && diag.d_func != nullptr) {
+        fprintf(f, "\t- from %s:%d\n\t- in %s\n", diag.d_file, diag.d_line, diag.d_func);
     }
 #endif
+}
+
+/* -=- (S/g)etters -=- */
+bool llama::Logger::has_error() {
+    return errored;
+}
 
-    if (type == Type::Panic) abort();
+size_t llama::Logger::size() {
+    return ring_size;
+}
 
-    // TODO: not abort in recoverable errors, looking out for more (like other normal and sane compilers)
-    if (type >= Type::SyntaxError && !recoverable) exit(-1);
-}
\ No newline at end of file
+size_t llama::Logger::dropped() {
+    return ring_dropped;
+}
+
+const llama::Logger::Diagnostic * llama::Logger::at(size_t idx) {
+    if (idx >= ring_size) return nullptr;
+    return &ring[(ring_start + idx) % LLAMA_LOG_RING];
+}
+
+/* -=- Formatters -=- */
+std::string llama::Logger::dump() {
+    std::string str;
+
+    char line[LLAMA_LOG_LINE];
+    for (size_t i = 0; i < ring_size; ++i) {
+        at(i)->format(line, sizeof(line));
+        str += line;
+    }
+
+    return str;
+}
+
+/* -=====================
+     Diagnostic class
+   =====================- */
+
+/* -=- Formatters -=- */
+size_t llama::Logger::Diagnostic::message(char * buf, size_t size) const {
+    // Works like snprintf(), the full length is returned even if the message was cut
+    size_t len = 0;
+    size_t pos = 0;
+
+    auto put = [&](int n) {
+        if (n > 0) len += n;
+    };
+    auto room = [&]() -> size_t {
+        return len < size ? size - len : 0;
+    };
+
+    for (const char * c = fmt; * c != '\0'; ++c) {
+        if (* c != '%') {
+            if (len + 1 < size) buf[len] = * c;
+            ++len;
+            continue;
+        }
+
+        ArgType arg;
+        const char * spec_start = c;
+        c = read_spec(c + 1, arg);
+        if (* c == '\0') break;
+
+        char spec[32];
+        size_t spec_len = c - spec_start + 1;
+        if (spec_len >= sizeof(spec)) spec_len = sizeof(spec) - 1;
+        memcpy(spec, spec_start, spec_len);
+        spec[spec_len] = '\0';
+
+        char * out = buf + (len < size ? len : 0);
+
+        if (arg == ArgType::None) {
+            put(snprintf(out, room(), "%s", * c == '%' ? "%" : spec));
+            continue;
+        }
+
+        // Arguments that didn't fit when the log was raised
+        if (pos >= args_size) {
+            put(snprintf(out, room(), "?"));
+            continue;
+        }
+
+        if (arg == ArgType::String) {
+            const char * str = (const char *)(args + pos);
+            put(snprintf(out, room(), spec, str));
+            pos += strlen(str) + 1;
+            continue;
+        }
+
+        uint64_t value;
+        memcpy(&value, args + pos, sizeof(value));
+        pos += sizeof(value);
+
+        bool u = is_unsigned(* c);
+        switch (arg) {
+            case ArgType::Int:      put(u ? snprintf(out, room(), spec, (unsigned)(value))           : snprintf(out, room(), spec, (int)(value)));       break;
+            case ArgType::Long:     put(u ? snprintf(out, room(), spec, (unsigned long)(value))      : snprintf(out, room(), spec, (long)(value)));      break;
+            case ArgType::LongLong: put(u ? snprintf(out, room(), spec, (unsigned long long)(value)) : snprintf(out, room(), spec, (long long)(value))); break;
+            case ArgType::Size:     put(snprintf(out, room(), spec, (size_t)(value)));    break;
+            case ArgType::Max:      put(u ? snprintf(out, room(), spec, (uintmax_t)(value))          : snprintf(out, room(), spec, (intmax_t)(value)));  break;
+            case ArgType::Ptrdiff:  put(snprintf(out, room(), spec, (ptrdiff_t)(value))); break;
+            case ArgType::Pointer:  put(snprintf(out, room(), spec, (void *)(uintptr_t)(value))); break;
+            case ArgType::Double: {
+                double d;
+                memcpy(&d, &value, sizeof(d));
+                put(snprintf(out, room(), spec, d));
+                break;
+            }
+            default: break;
+        }
+    }
+
+    if (size > 0) buf[len < size ? len : size - 1] = '\0';
+
+    return len;
+}
+
+size_t llama::Logger::Diagnostic::format(char * buf, size_t size) const {
+    // The whole line as it gets printed, ending in a newline
+    static const char * prefixes[] = {
+        "info", "warning", "syntax error", "runtime error", "type error", "PANIC!"
+    };
+
+    size_t len = 0;
+    auto append = [&](const char * str) {
+        for (; * str != '\0'; ++str, ++len) {
+            if (len + 1 < size) buf[len] = * str;
+        }
+    };
+    auto out = [&]() -> char * {
+        return buf + (len < size ? len : size);
+    };
+    auto room = [&]() -> size_t {
+        return len < size ? size - len : 0;
+    };
+
+    if (source[0] != '\0') {
+        append(source);
+        append(":");
+    }
+
+    if (line > 0) {
+        int n = snprintf(out(), room(), "%zu:%zu: ", line, collumn);
+        if (n > 0) len += n;
+    } else if (source[0] != '\0') {
+        append(" ");
+    }
+
+    append(prefixes[type]);
+    append(type == Type::Panic ? " " : ": ");
+
+    len += message(out(), room());
+
+    // Cut lines keep their newline
+    if (len + 1 < size) {
+        buf[len++] = '\n';
+        buf[len]   = '\0';
+    } else if (size >= 2) {
+        buf[size - 2] = '\n';
+        buf[size - 1] = '\0';
+        ++len;
+    }
+
+    return len;
+}
@@ -0,0 +1,397 @@
+/* -=============
+     Includes
+   =============- */
+
+#include <folder.h>
+#include <ast.h>
+#include <arena.h>
+#include <module.h>
+
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+/* -=================
+     Folder class
+   =================- */
+
+/* -=- (Con/des)tructors -=- */
+llama::Folder::Folder() {
+    mod   = nullptr;
+    arena = nullptr;
+}
+
+/* -=- Base functions -=- */
+void llama::Folder::setup(Module * m_mod, Arena * m_arena) {
+    mod   = m_mod;
+    arena = m_arena;
+}
+
+void llama::Folder::fold(Node * node) {
+    Known known;
+
+    switch (node->kind) {
+        case Node::Kind::ExprStmt: {
+            ExprStmtNode * stmt = node->as<ExprStmtNode>();
+            stmt->expr = fold_expr(stmt->expr, known);
+            break;
+        }
+        case Node::Kind::Decl: {
+            DeclNode * decl = node->as<DeclNode>();
+            if (decl->value != nullptr) decl->value = fold_expr(decl->value, known);
+            break;
+        }
+        case Node::Kind::Block: {
+            fold_block(node->as<BlockNode>());
+            break;
+        }
+        case Node::Kind::If: {
+            IfNode * stmt = node->as<IfNode>();
+            stmt->cond = fold_expr(stmt->cond, known);
+            fold_block(stmt->then);
+            if (stmt->otherwise != nullptr) fold_block(stmt->otherwise);
+            break;
+        }
+        case Node::Kind::While: {
+            WhileNode * stmt = node->as<WhileNode>();
+            stmt->cond = fold_expr(stmt->cond, known);
+            fold_block(stmt->body);
+            break;
+        }
+        case Node::Kind::Loop: {
+            fold_block(node->as<LoopNode>()->body);
+            break;
+        }
+        case Node::Kind::Fn: {
+            fold_block(node->as<FnNode>()->body);
+            break;
+        }
+        case Node::Kind::Return: {
+            ReturnNode * stmt = node->as<ReturnNode>();
+            if (stmt->value != nullptr) stmt->value = fold_expr(stmt->value, known);
+            break;
+        }
+        default: break;
+    }
+}
+
+void llama::Folder::fold_block(BlockNode * node) {
+    for (size_t i = 0; i < node->body.size; ++i) fold(node->body.items[i]);
+}
+
+/* -=- Expressions -=- */
+llama::Node * llama::Folder::fold_expr(Node * node, Known & known) {
+    known = Known::Nothing;
+
+    switch (node->kind) {
+        case Node::Kind::Null:    { known = Known::Null;   break; }
+        case Node::Kind::True:
+        case Node::Kind::False:   { known = Known::Bool;   break; }
+        case Node::Kind::Integer: { known = Known::Int;    break; }
+        case Node::Kind::Decimal: { known = Known::Float;  break; }
+        case Node::Kind::String:  { known = Known::String; break; }
+        case Node::Kind::Property: {
+            PropertyNode * property = node->as<PropertyNode>();
+            Known object;
+            property->object = fold_expr(property->object, object);
+            break;
+        }
+        case Node::Kind::Unary:  return fold_unary(node->as<UnaryNode>(), known);
+        case Node::Kind::Binary: return fold_binary(node->as<BinaryNode>(), known);
+        case Node::Kind::Call: {
+            CallNode * call = node->as<CallNode>();
+            Known arg;
+            call->callee = fold_expr(call->callee, arg);
+            for (size_t i = 0; i < call->args.size; ++i) call->args.items[i] = fold_expr(call->args.items[i], arg);
+            break;
+        }
+        case Node::Kind::Assign: {
+            // Assignments give the value they store
+            AssignNode * assign = node->as<AssignNode>();
+            assign->value = fold_expr(assign->value, known);
+            break;
+        }
+        case Node::Kind::SetProperty: {
+            SetPropertyNode * set = node->as<SetPropertyNode>();
+            Known value;
+            set->value = fold_expr(set->value, value);
+            break;
+        }
+        default: break;
+    }
+
+    return node;
+}
+
+llama::Node * llama::Folder::fold_unary(UnaryNode * node, Known & known) {
+    Known operand;
+    node->operand = fold_expr(node->operand, operand);
+
+    known = Known::Nothing;
+    if (node->op == Token::Type::Not) {
+        if (operand == Known::Bool) known = Known::Bool;
+    } else if (operand == Known::Int || operand == Known::Float) {
+        known = operand;
+    }
+
+    Constant value;
+    if (constant(node->operand, value)) {
+        // Values the runtime can't take stay as they are, and fail there
+        if (node->op == Token::Type::Not) {
+            if (value.type != Known::Bool) return node;
+            value.boolean = !value.boolean;
+        } else if (value.type == Known::Int) {
+            if (node->op == Token::Type::Minus) value.integer = (int)(0u - (uint32_t)(value.integer));
+        } else if (value.type == Known::Float) {
+            if (node->op == Token::Type::Minus) value.decimal = -value.decimal;
+        } else {
+            return node;
+        }
+
+        mod->add_folded(1);
+        return make_constant(node, value);
+    }
+
+    // Applied twice, negating and not give back their operand, promoting numbers does nothing
+    if (known == Known::Nothing) return node;
+
+    if (node->op == Token::Type::Plus) {
+        mod->add_folded(1);
+        return node->operand;
+    }
+
+    if (node->operand->kind == Node::Kind::Unary && node->operand->as<UnaryNode>()->op == node->op) {
+        mod->add_folded(2);
+        return node->operand->as<UnaryNode>()->operand;
+    }
+
+    return node;
+}
+
+llama::Node * llama::Folder::fold_binary(BinaryNode * node, Known & known) {
+    Known lhs, rhs;
+    node->lhs = fold_expr(node->lhs, lhs);
+    node->rhs = fold_expr(node->rhs, rhs);
+
+    known = Known::Nothing;
+    switch (node->op) {
+        case Token::Type::Equals:
+        case Token::Type::NotEquals:
+        case Token::Type::Lesser:
+        case Token::Type::LeEquals:
+        case Token::Type::Greater:
+        case Token::Type::GrEquals: {
+            // Comparisons never fail, whatever they compare
+            known = Known::Bool;
+            break;
+        }
+        case Token::Type::And:
+        case Token::Type::Or: {
+            if (lhs == Known::Bool) known = Known::Bool;
+            break;
+        }
+        default: {
+            if (lhs == rhs && (lhs == Known::Int || lhs == Known::Float)) known = lhs;
+            break;
+        }
+    }
+
+    Constant a, b, result;
+    if (constant(node->lhs, a) && constant(node->rhs, b)) {
+        if (!compute(node->op, a, b, result)) return node;
+
+        mod->add_folded(2);
+        return make_constant(node, result);
+    }
+
+    // Identities keep the other operand, which has to be of a type the operator takes untouched
+    if (is_identity(node->op, node->rhs, lhs, true)) {
+        mod->add_folded(2);
+        return node->lhs;
+    }
+    if (is_identity(node->op, node->lhs, rhs, false)) {
+        mod->add_folded(2);
+        return node->rhs;
+    }
+
+    return node;
+}
+
+/* -=- Constants -=- */
+bool llama::Folder::constant(Node * node, Constant & value) {
+    value = Constant();
+
+    switch (node->kind) {
+        case Node::Kind::Null:    { value.type = Known::Null;                                                     return true; }
+        case Node::Kind::True:    { value.type = Known::Bool;   value.boolean = true;                             return true; }
+        case Node::Kind::False:   { value.type = Known::Bool;   value.boolean = false;                            return true; }
+        case Node::Kind::Integer: { value.type = Known::Int;    value.integer = node->as<IntegerNode>()->value;   return true; }
+        case Node::Kind::Decimal: { value.type = Known::Float;  value.decimal = node->as<DecimalNode>()->value;   return true; }
+        case Node::Kind::String:  { value.type = Known::String; value.str     = node->as<StringNode>()->str;      return true; }
+        default:                  return false;
+    }
+}
+
+llama::Node * llama::Folder::make_constant(Node * at, const Constant & value) {
+    Node * node = nullptr;
+
+    switch (value.type) {
+        case Known::Bool: {
+            node = arena->make<Node>();
+            node->kind = value.boolean ? Node::Kind::True : Node::Kind::False;
+            break;
+        }
+        case Known::Int: {
+            IntegerNode * integer = arena->make<IntegerNode>();
+            integer->kind  = Node::Kind::Integer;
+            integer->value = value.integer;
+            node = integer;
+            break;
+        }
+        case Known::Float: {
+            DecimalNode * decimal = arena->make<DecimalNode>();
+            decimal->kind  = Node::Kind::Decimal;
+            decimal->value = value.decimal;
+            node = decimal;
+            break;
+        }
+        default: return at;
+    }
+
+    node->start  = at->start;
+    node->length = at->length;
+
+    return node;
+}
+
+bool llama::Folder::compute(Token::Type op, const Constant & a, const Constant & b, Constant & result) {
+    result = Constant();
+
+    // Same results as Value, integer arithmetic wraps through uint32_t on both sides
+    switch (op) {
+        case Token::Type::Equals:
+        case Token::Type::NotEquals: {
+            bool eq = a.type == b.type;
+            if (eq) {
+                switch (a.type) {
+                    case Known::Bool:   { eq = a.boolean == b.boolean;        break; }
+                    case Known::Int:    { eq = a.integer == b.integer;        break; }
+                    case Known::Float:  { eq = a.decimal == b.decimal;        break; }
+                    case Known::String: { eq = strcmp(a.str, b.str) == 0;     break; }
+                    default:            break;
+                }
+            }
+
+            result.type    = Known::Bool;
+            result.boolean = op == Token::Type::Equals ? eq : !eq;
+            return true;
+        }
+        case Token::Type::Lesser:
+        case Token::Type::LeEquals:
+        case Token::Type::Greater:
+        case Token::Type::GrEquals: {
+            // Anything but two bools, ints or floats compares as false
+            double x = 0.0, y = 0.0;
+            bool   ordered = a.type == b.type && (a.type == Known::Bool || a.type == Known::Int || a.type == Known::Float);
+            if (ordered && a.type == Known::Bool) { x = a.boolean; y = b.boolean; }
+            if (ordered && a.type == Known::Int)  { x = a.integer; y = b.integer; }
+            if (ordered && a.type == Known::Float) { x = a.decimal; y = b.decimal; }
+
+            result.type = Known::Bool;
+            if (!ordered)                        result.boolean = false;
+            else if (op == Token::Type::Lesser)   result.boolean = x < y;
+            else if (op == Token::Type::LeEquals) result.boolean = x <= y;
+            else if (op == Token::Type::Greater)  result.boolean = x > y;
+            else                                  result.boolean = x >= y;
+            return true;
+        }
+        case Token::Type::And:
+        case Token::Type::Or: {
+            if (a.type != Known::Bool || b.type != Known::Bool) return false;
+
+            result.type    = Known::Bool;
+            result.boolean = op == Token::Type::And ? a.boolean && b.boolean : a.boolean || b.boolean;
+            return true;
+        }
+        default: break;
+    }
+
+    // Arithmetic only takes two ints or two floats
+    if (a.type != b.type) return false;
+
+    if (a.type == Known::Int) {
+        uint32_t x = (uint32_t)(a.integer), y = (uint32_t)(b.integer);
+
+        result.type = Known::Int;
+        switch (op) {
+            case Token::Type::Plus:     { result.integer = (int)(x + y); return true; }
+            case Token::Type::Minus:    { result.integer = (int)(x - y); return true; }
+            case Token::Type::Multiply: { result.integer = (int)(x * y); return true; }
+            case Token::Type::Divide:
+            case Token::Type::Modulo: {
+                // The runner reports these as errors, so they're left to it
+                if (b.integer == 0 || (a.integer == INT_MIN && b.integer == -1)) return false;
+                result.integer = op == Token::Type::Divide ? a.integer / b.integer : a.integer % b.integer;
+                return true;
+            }
+            case Token::Type::Power: {
+                double v = pow(a.integer, b.integer);
+                if (!(v >= (double)(INT_MIN) && v <= (double)(INT_MAX))) return false;
+                result.integer = (int)(v);
+                return true;
+            }
+            default: return false;
+        }
+    }
+
+    if (a.type == Known::Float) {
+        result.type = Known::Float;
+        switch (op) {
+            case Token::Type::Plus:     { result.decimal = a.decimal + b.decimal;                   return true; }
+            case Token::Type::Minus:    { result.decimal = a.decimal - b.decimal;                   return true; }
+            case Token::Type::Multiply: { result.decimal = a.decimal * b.decimal;                   return true; }
+            case Token::Type::Divide:   { result.decimal = a.decimal / b.decimal;                   return true; }
+            case Token::Type::Modulo:   { result.decimal = fmod(a.decimal, b.decimal);              return true; }
+            case Token::Type::Power:    { result.decimal = (double)(powf(a.decimal, b.decimal));    return true; }
+            default:                    return false;
+        }
+    }
+
+    return false;
+}
+
+bool llama::Folder::is_identity(Token::Type op, Node * operand, Known known, bool right) {
+    Constant value;
+    if (!constant(operand, value) || value.type != known) return false;
+
+    switch (known) {
+        case Known::Int: {
+            switch (op) {
+                case Token::Type::Plus:     return value.integer == 0;
+                case Token::Type::Multiply: return value.integer == 1;
+                case Token::Type::Minus:    return right && value.integer == 0;
+                case Token::Type::Divide:   return right && value.integer == 1;
+                default:                    return false;
+            }
+        }
+        case Known::Float: {
+            // x + 0.0 isn't x for x = -0.0, x - 0.0 always is
+            switch (op) {
+                case Token::Type::Multiply: return value.decimal == 1.0;
+                case Token::Type::Minus:    return right && value.decimal == 0.0 && !std::signbit(value.decimal);
+                case Token::Type::Divide:   return right && value.decimal == 1.0;
+                default:                    return false;
+            }
+        }
+        case Known::Bool: {
+            // The left operand has to be a bool for the runtime to take it, the right one doesn't
+            switch (op) {
+                case Token::Type::And: return value.boolean;
+                case Token::Type::Or:  return !value.boolean;
+                default:               return false;
+            }
+        }
+        default: return false;
+    }
+}
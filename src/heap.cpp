@@ -0,0 +1,289 @@
+/* -=============
+     Includes
+   =============- */
+
+#include <error.h>
+#include <heap.h>
+#include <vm.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+
+/* -==============
+     Internals
+   ==============- */
+
+#define HEAP_MIN_THRESHOLD (64 * 1024) // First collection threshold, in bytes
+#define HEAP_CLOCK_STRIDE  64          // Work units between two checks of the step clock
+
+namespace llama {
+    typedef std::chrono::steady_clock Clock;
+
+    static size_t micros_since(Clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+    }
+}
+
+/* -===============
+     Heap class
+   ===============- */
+
+/* -=- (Con/des)tructors -=- */
+llama::Heap::Heap(VM * m_vm, Allocator * m_allocator, size_t m_limit, bool m_incremental, size_t m_budget) {
+    vm          = m_vm;
+    allocator   = m_allocator;
+    state       = Idle;
+    objects     = nullptr;
+    sweeping    = nullptr;
+    used        = 0;
+    limit       = m_limit;
+    next_gc     = (limit > 0 && limit < HEAP_MIN_THRESHOLD) ? limit : HEAP_MIN_THRESHOLD;
+    collections = 0;
+    incremental = m_incremental;
+    budget      = m_budget;
+    max_pause   = 0;
+
+    gray_cap      = 0;
+    gray_overflow = false;
+
+    memset(pauses, 0, sizeof(pauses));
+    memset(last_pauses, 0, sizeof(last_pauses));
+}
+
+llama::Heap::~Heap() {
+    HeapObject * lists[] = { objects, sweeping };
+    for (HeapObject * obj : lists) {
+        while (obj != nullptr) {
+            HeapObject * next = obj->next;
+            allocator->release(obj, sizeof(HeapObject) + obj->size);
+            obj = next;
+        }
+    }
+
+    delete allocator;
+}
+
+/* -=- Allocation -=- */
+llama::HeapObject * llama::Heap::alloc(Type type, const void * payload, size_t size) {
+    size_t bytes = sizeof(HeapObject) + size;
+
+    // Incremental cycles advance a bit on every allocation, while stop-the-world ones only run
+    // once the threshold is crossed
+    if (incremental) {
+        if (state == Idle && used + bytes > next_gc) begin_cycle();
+        if (state != Idle) step();
+    } else if (used + bytes > next_gc) {
+        collect();
+    }
+
+    // Gives up only when even a full collection can't make room under the limit
+    if (limit > 0 && used + bytes > limit) {
+        collect();
+        if (used + bytes > limit) return nullptr;
+    }
+
+    // A fixed region runs out before the limit does, so its exhaustion gets a collection as well
+    HeapObject * obj = (HeapObject *)(allocator->alloc(bytes));
+    if (obj == nullptr) {
+        collect();
+        obj = (HeapObject *)(allocator->alloc(bytes));
+        if (obj == nullptr) return nullptr;
+    }
+
+    // Objects born while marking are black, the sweeper never sees the ones born after it started
+    obj->next   = objects;
+    obj->size   = size;
+    obj->type   = type;
+    obj->marked = state == Mark;
+    if (payload != nullptr) memcpy(obj + 1, payload, size);
+
+    objects  = obj;
+    used    += bytes;
+
+    return obj;
+}
+
+/* -=- Collection -=- */
+void llama::Heap::collect() {
+    Clock::time_point start = Clock::now();
+
+    // A cycle already running keeps everything born while it marked (they are black), so it is
+    // only finished here and a fresh one does the actual full collection
+    while (state != Idle) work(false);
+
+    begin_cycle();
+    while (state != Idle) work(false);
+
+    record(micros_since(start));
+}
+
+void llama::Heap::step() {
+    if (state == Idle) return;
+
+    Clock::time_point start = Clock::now();
+    work(true);
+    record(micros_since(start));
+}
+
+void llama::Heap::fix_gray(size_t count) {
+    // Reserved once so that marking never has to call the system allocator
+    gray.reserve(count);
+    gray_cap = count;
+}
+
+void llama::Heap::begin_cycle() {
+    state = Mark;
+    mark_roots();
+}
+
+void llama::Heap::end_cycle() {
+    state = Idle;
+    ++collections;
+
+    memcpy(last_pauses, pauses, sizeof(pauses));
+    memset(pauses, 0, sizeof(pauses));
+
+    // The next cycle waits until the heap doubles, without going past the limit
+    next_gc = used * 2 > HEAP_MIN_THRESHOLD ? used * 2 : HEAP_MIN_THRESHOLD;
+    if (limit > 0 && next_gc > limit) next_gc = limit;
+}
+
+void llama::Heap::work(bool bounded) {
+    Clock::time_point start = Clock::now();
+
+    size_t units = 0;
+    while (state != Idle) {
+        if (bounded && ++units % HEAP_CLOCK_STRIDE == 0 && micros_since(start) >= budget) return;
+
+        if (state == Mark) {
+            if (!gray.empty()) {
+                HeapObject * obj = gray.back();
+                gray.pop_back();
+                trace(obj);
+                continue;
+            }
+
+            // Marked objects that didn't fit in the gray stack are found again by walking the heap,
+            // tracing is idempotent so the ones already traced don't matter
+            if (gray_overflow) {
+                gray_overflow = false;
+                for (HeapObject * obj = objects; obj != nullptr; obj = obj->next) {
+                    if (obj->marked) trace(obj);
+                }
+                continue;
+            }
+
+            // The stack is mutated without barriers, so it is rescanned before marking can end
+            mark_roots();
+            if (!gray.empty()) continue;
+
+            state    = Sweep;
+            sweeping = objects;
+            objects  = nullptr;
+        } else {
+            if (sweeping == nullptr) {
+                end_cycle();
+                break;
+            }
+
+            HeapObject * obj = sweeping;
+            sweeping = obj->next;
+
+            if (obj->marked) {
+                obj->marked = false;
+                obj->next   = objects;
+                objects     = obj;
+            } else {
+                used -= sizeof(HeapObject) + obj->size;
+                allocator->release(obj, sizeof(HeapObject) + obj->size);
+            }
+        }
+    }
+}
+
+void llama::Heap::mark_roots() {
+    // Every value below the stack pointer is live, frames only point into that same stack
+    for (Value * v = vm->stack; v < vm->sp; ++v) barrier(* v);
+    for (size_t i = 0; i < vm->global_count; ++i) barrier(vm->globals[i]);
+}
+
+void llama::Heap::shade(HeapObject * obj) {
+    obj->marked = true;
+
+    if (gray_cap > 0 && gray.size() >= gray_cap) {
+        gray_overflow = true;
+        return;
+    }
+    gray.push_back(obj);
+}
+
+void llama::Heap::trace(HeapObject * obj) {
+    // Lists hold their elements inline
+    if (obj->type == Type::List) {
+        Value * items = (Value *)(obj + 1);
+        for (size_t i = 0; i < obj->size / sizeof(Value); ++i) barrier(items[i]);
+    }
+}
+
+void llama::Heap::record(size_t micros) {
+    size_t bucket = 0;
+    while (bucket < LLAMA_GC_BUCKETS - 1 && micros >= ((size_t)(1) << bucket)) ++bucket;
+
+    if (micros > max_pause) max_pause = micros;
+
+    // The pause that ended a cycle is only known once its histogram was moved
+    if (state == Idle) ++last_pauses[bucket];
+    else               ++pauses[bucket];
+}
+
+/* -=- (S/g)etters -=- */
+llama::Heap::State llama::Heap::get_state() {
+    return state;
+}
+
+size_t llama::Heap::get_used() {
+    return used;
+}
+
+size_t llama::Heap::get_limit() {
+    return limit;
+}
+
+size_t llama::Heap::get_collections() {
+    return collections;
+}
+
+size_t llama::Heap::get_max_pause() {
+    return max_pause;
+}
+
+llama::Allocator * llama::Heap::get_allocator() {
+    return allocator;
+}
+
+const size_t * llama::Heap::get_histogram() {
+    return last_pauses;
+}
+
+/* -=- Base functions -=- */
+std::string llama::Heap::dump() {
+    std::string str;
+
+    char line[64];
+    snprintf(line, sizeof(line), "%zu bytes in use, %zu cycles, max pause %zuus\n", used, collections, max_pause);
+    str += line;
+    str += allocator->dump();
+
+    for (size_t i = 0; i < LLAMA_GC_BUCKETS; ++i) {
+        if (i + 1 < LLAMA_GC_BUCKETS) snprintf(line, sizeof(line), "< %6zuus: %zu\n", (size_t)(1) << i, last_pauses[i]);
+        else                          snprintf(line, sizeof(line), ">= %5zuus: %zu\n", (size_t)(1) << (i - 1), last_pauses[i]);
+        str += line;
+    }
+
+    return str;
+}
@@ -2,6 +2,7 @@
      Includes
    =============- */
 
+#include <error.h>
 #include <ir.h>
 #include <bytecode.h>
 #include <module.h>
@@ -24,79 +25,83 @@
 
 namespace llama {
     static std::map<unsigned char, InstInfo> insts = {
-        DEF_OP(NOP,         0, 0), 
-        DEF_OP(JP,          1, 0), 
-        DEF_OP(JZ,          1, 0), 
-        DEF_OP(JNZ,         1, 0), 
-        DEF_OP(BLOCK,       1, GET_FLAG(IMMUTARG) | GET_FLAG(ISBLOCK)), 
-        DEF_OP(IF,          1, GET_FLAG(IMMUTARG) | GET_FLAG(ISBLOCK)), 
-        DEF_OP(ELSE,        1, GET_FLAG(IMMUTARG) | GET_FLAG(ISBLOCK) | GET_FLAG(ISEND)), 
-        DEF_OP(LOOP,        1, GET_FLAG(IMMUTARG) | GET_FLAG(ISBLOCK)), 
-        DEF_OP(REPEAT,      0, 0), 
-        DEF_OP(BREAK,       0, GET_FLAG(ISEND)), 
-        DEF_OP(END,         1, GET_FLAG(IMMUTARG) | GET_FLAG(ISEND)), 
-        DEF_OP(PUSHNULL,    0, 0), 
-        DEF_OP(PUSHTRUE,    0, 0), 
-        DEF_OP(PUSHFALSE,   0, 0), 
-        DEF_OP(PUSHINT,     1, GET_FLAG(CONSTARG)), 
-        DEF_OP(PUSHFLOAT,   1, GET_FLAG(CONSTARG)), 
-        DEF_OP(PUSHSTRING,  1, GET_FLAG(CONSTARG)), 
-        DEF_OP(PUSHLIST,    0, 0), 
-        DEF_OP(PUSHOBJECT,  1, GET_FLAG(CONSTARG)), 
-        DEF_OP(PUSHDYN,     0, 0), 
-        DEF_OP(PUSHFUNC,    1, GET_FLAG(CONSTARG)), 
-        DEF_OP(SETGLOBAL,   2, GET_FLAG(CONSTARG) | GET_FLAG(STACKARG)), 
-        DEF_OP(GETGLOBAL,   1, GET_FLAG(CONSTARG)), 
-        DEF_OP(SETPROPERTY, 2, GET_FLAG(STACKARG) | GET_FLAG(CONSTARG)), 
-        DEF_OP(GETPROPERTY, 2, GET_FLAG(STACKARG) | GET_FLAG(CONSTARG)), 
-        DEF_OP(SETINDEX,    1, GET_FLAG(STACKARG)), 
-        DEF_OP(GETINDEX,    1, GET_FLAG(STACKARG)), 
-        DEF_OP(NEWGLOBAL,   1, GET_FLAG(CONSTARG)), 
-        DEF_OP(NEWLOCAL,    1, GET_FLAG(CONSTARG)), 
-        DEF_OP(POP,         0, 0), 
-        DEF_OP(POPN,        1, GET_FLAG(IMMUTARG)), 
-        DEF_OP(ADD,         0, GET_FLAG(STACKARG)), 
-        DEF_OP(SUB,         0, GET_FLAG(STACKARG)), 
-        DEF_OP(MUL,         0, GET_FLAG(STACKARG)), 
-        DEF_OP(DIV,         0, GET_FLAG(STACKARG)), 
-        DEF_OP(MOD,         0, GET_FLAG(STACKARG)), 
-        DEF_OP(POW,         0, GET_FLAG(STACKARG)), 
-        DEF_OP(NEGATE,      0, GET_FLAG(STACKARG)), 
-        DEF_OP(PROMOTE,     0, GET_FLAG(STACKARG)), 
-        DEF_OP(BITNOT,      0, GET_FLAG(STACKARG)), 
-        DEF_OP(BITAND,      0, GET_FLAG(STACKARG)), 
-        DEF_OP(BITOR,       0, GET_FLAG(STACKARG)), 
-        DEF_OP(BITXOR,      0, GET_FLAG(STACKARG)), 
-        DEF_OP(BITSHL,      0, GET_FLAG(STACKARG)), 
-        DEF_OP(BITSHR,      0, GET_FLAG(STACKARG)), 
-        DEF_OP(BITROL,      0, GET_FLAG(STACKARG)), 
-        DEF_OP(BITROR,      0, GET_FLAG(STACKARG)), 
-        DEF_OP(NOT,         0, GET_FLAG(STACKARG)), 
-        DEF_OP(AND,         0, GET_FLAG(STACKARG)), 
-        DEF_OP(OR,          0, GET_FLAG(STACKARG)), 
-        DEF_OP(EQ,          0, GET_FLAG(STACKARG)), 
-        DEF_OP(LT,          0, GET_FLAG(STACKARG)), 
-        DEF_OP(LE,          0, GET_FLAG(STACKARG)), 
-        DEF_OP(GT,          0, GET_FLAG(STACKARG)), 
-        DEF_OP(GE,          0, GET_FLAG(STACKARG)), 
-        DEF_OP(NE,          0, GET_FLAG(STACKARG)), 
-        DEF_OP(SIZEOF,      0, GET_FLAG(STACKARG)), 
-        DEF_OP(LENOF,       0, GET_FLAG(STACKARG)), 
-        DEF_OP(TYPEOF,      0, GET_FLAG(STACKARG)), 
-        DEF_OP(INSTANCEOF,  0, GET_FLAG(STACKARG)), 
-        DEF_OP(THIS,        0, 0), 
-        DEF_OP(AS,          0, GET_FLAG(STACKARG)), 
-        DEF_OP(CALL,        1, GET_FLAG(IMMUTARG) | GET_FLAG(STACKARG)), 
-        DEF_OP(CALLV,       1, GET_FLAG(IMMUTARG) | GET_FLAG(STACKARG)), 
-        DEF_OP(RETURN,      0, GET_FLAG(STACKARG)), 
-        DEF_OP(RETURNV,     0, 0), 
-        DEF_OP(BREAKPOINT,  0, 0), 
-        DEF_OP(REF,         0, 0), 
-        DEF_OP(REFGLOBAL,   1, GET_FLAG(CONSTARG)), 
-        DEF_OP(REFPROPERTY, 1, GET_FLAG(CONSTARG)), 
-        DEF_OP(REFINDEX,    1, GET_FLAG(IMMUTARG)), 
-        DEF_OP(REFSET,      1, GET_FLAG(IMMUTARG)), 
-        DEF_OP(TYPECHECK,   1, GET_FLAG(CONSTARG) | GET_FLAG(STACKARG)), 
+        DEF_OP(NOP,            0, 0), 
+        DEF_OP(JP,             1, 0), 
+        DEF_OP(JZ,             1, 0), 
+        DEF_OP(JNZ,            1, 0), 
+        DEF_OP(BLOCK,          1, GET_FLAG(IMMUTARG) | GET_FLAG(ISBLOCK)), 
+        DEF_OP(IF,             1, GET_FLAG(IMMUTARG) | GET_FLAG(ISBLOCK)), 
+        DEF_OP(ELSE,           1, GET_FLAG(IMMUTARG) | GET_FLAG(ISBLOCK) | GET_FLAG(ISEND)), 
+        DEF_OP(LOOP,           1, GET_FLAG(IMMUTARG) | GET_FLAG(ISBLOCK)), 
+        DEF_OP(REPEAT,         0, 0), 
+        DEF_OP(BREAK,          0, GET_FLAG(ISEND)), 
+        DEF_OP(END,            1, GET_FLAG(IMMUTARG) | GET_FLAG(ISEND)), 
+        DEF_OP(PUSHNULL,       0, 0), 
+        DEF_OP(PUSHTRUE,       0, 0), 
+        DEF_OP(PUSHFALSE,      0, 0), 
+        DEF_OP(PUSHINT,        1, GET_FLAG(CONSTARG)), 
+        DEF_OP(PUSHFLOAT,      1, GET_FLAG(CONSTARG)), 
+        DEF_OP(PUSHSTRING,     1, GET_FLAG(CONSTARG)), 
+        DEF_OP(PUSHLIST,       0, 0), 
+        DEF_OP(PUSHOBJECT,     1, GET_FLAG(CONSTARG)), 
+        DEF_OP(PUSHDYN,        0, 0), 
+        DEF_OP(PUSHFUNC,       1, GET_FLAG(IMMUTARG)), 
+        DEF_OP(SETGLOBAL,      2, GET_FLAG(CONSTARG) | GET_FLAG(STACKARG)), 
+        DEF_OP(GETGLOBAL,      1, GET_FLAG(CONSTARG)), 
+        DEF_OP(SETPROPERTY,    2, GET_FLAG(STACKARG) | GET_FLAG(CONSTARG)), 
+        DEF_OP(GETPROPERTY,    2, GET_FLAG(STACKARG) | GET_FLAG(CONSTARG)), 
+        DEF_OP(SETINDEX,       1, GET_FLAG(STACKARG)), 
+        DEF_OP(GETINDEX,       1, GET_FLAG(STACKARG)), 
+        DEF_OP(NEWGLOBAL,      1, GET_FLAG(IMMUTARG) | GET_FLAG(SLOTARG)), 
+        DEF_OP(NEWLOCAL,       1, GET_FLAG(IMMUTARG)), 
+        DEF_OP(GETLOCAL,       1, GET_FLAG(IMMUTARG)), 
+        DEF_OP(SETLOCAL,       1, GET_FLAG(IMMUTARG) | GET_FLAG(STACKARG)), 
+        DEF_OP(GETGLOBAL_SLOT, 1, GET_FLAG(IMMUTARG) | GET_FLAG(SLOTARG)), 
+        DEF_OP(SETGLOBAL_SLOT, 1, GET_FLAG(IMMUTARG) | GET_FLAG(SLOTARG) | GET_FLAG(STACKARG)), 
+        DEF_OP(POP,            0, 0), 
+        DEF_OP(POPN,           1, GET_FLAG(IMMUTARG)), 
+        DEF_OP(ADD,            0, GET_FLAG(STACKARG)), 
+        DEF_OP(SUB,            0, GET_FLAG(STACKARG)), 
+        DEF_OP(MUL,            0, GET_FLAG(STACKARG)), 
+        DEF_OP(DIV,            0, GET_FLAG(STACKARG)), 
+        DEF_OP(MOD,            0, GET_FLAG(STACKARG)), 
+        DEF_OP(POW,            0, GET_FLAG(STACKARG)), 
+        DEF_OP(NEGATE,         0, GET_FLAG(STACKARG)), 
+        DEF_OP(PROMOTE,        0, GET_FLAG(STACKARG)), 
+        DEF_OP(BITNOT,         0, GET_FLAG(STACKARG)), 
+        DEF_OP(BITAND,         0, GET_FLAG(STACKARG)), 
+        DEF_OP(BITOR,          0, GET_FLAG(STACKARG)), 
+        DEF_OP(BITXOR,         0, GET_FLAG(STACKARG)), 
+        DEF_OP(BITSHL,         0, GET_FLAG(STACKARG)), 
+        DEF_OP(BITSHR,         0, GET_FLAG(STACKARG)), 
+        DEF_OP(BITROL,         0, GET_FLAG(STACKARG)), 
+        DEF_OP(BITROR,         0, GET_FLAG(STACKARG)), 
+        DEF_OP(NOT,            0, GET_FLAG(STACKARG)), 
+        DEF_OP(AND,            0, GET_FLAG(STACKARG)), 
+        DEF_OP(OR,             0, GET_FLAG(STACKARG)), 
+        DEF_OP(EQ,             0, GET_FLAG(STACKARG)), 
+        DEF_OP(LT,             0, GET_FLAG(STACKARG)), 
+        DEF_OP(LE,             0, GET_FLAG(STACKARG)), 
+        DEF_OP(GT,             0, GET_FLAG(STACKARG)), 
+        DEF_OP(GE,             0, GET_FLAG(STACKARG)), 
+        DEF_OP(NE,             0, GET_FLAG(STACKARG)), 
+        DEF_OP(SIZEOF,         0, GET_FLAG(STACKARG)), 
+        DEF_OP(LENOF,          0, GET_FLAG(STACKARG)), 
+        DEF_OP(TYPEOF,         0, GET_FLAG(STACKARG)), 
+        DEF_OP(INSTANCEOF,     0, GET_FLAG(STACKARG)), 
+        DEF_OP(THIS,           0, 0), 
+        DEF_OP(AS,             1, GET_FLAG(CONSTARG) | GET_FLAG(STACKARG)), 
+        DEF_OP(CALL,           1, GET_FLAG(IMMUTARG) | GET_FLAG(STACKARG)), 
+        DEF_OP(CALLV,          1, GET_FLAG(IMMUTARG) | GET_FLAG(STACKARG)), 
+        DEF_OP(RETURN,         0, GET_FLAG(STACKARG)), 
+        DEF_OP(RETURNV,        0, 0), 
+        DEF_OP(BREAKPOINT,     0, 0), 
+        DEF_OP(REF,            0, 0), 
+        DEF_OP(REFGLOBAL,      1, GET_FLAG(CONSTARG)), 
+        DEF_OP(REFPROPERTY,    1, GET_FLAG(CONSTARG)), 
+        DEF_OP(REFINDEX,       1, GET_FLAG(IMMUTARG)), 
+        DEF_OP(REFSET,         1, GET_FLAG(IMMUTARG)), 
+        DEF_OP(TYPECHECK,      1, GET_FLAG(CONSTARG) | GET_FLAG(STACKARG)), 
     };
 }
 
@@ -277,12 +282,28 @@ void llama::IRBuilder::_getindex(int idx) {
     ops.push_back(InstData(GET_OP(GETINDEX), idx));
 }
 
-void llama::IRBuilder::_newglobal(int name) {
-    ops.push_back(InstData(GET_OP(NEWGLOBAL), name));
+void llama::IRBuilder::_newglobal(int slot) {
+    ops.push_back(InstData(GET_OP(NEWGLOBAL), slot));
 }
 
-void llama::IRBuilder::_newlocal(int name) {
-    ops.push_back(InstData(GET_OP(NEWLOCAL), name));
+void llama::IRBuilder::_newlocal(int slot) {
+    ops.push_back(InstData(GET_OP(NEWLOCAL), slot));
+}
+
+void llama::IRBuilder::_getlocal(int slot) {
+    ops.push_back(InstData(GET_OP(GETLOCAL), slot));
+}
+
+void llama::IRBuilder::_setlocal(int slot) {
+    ops.push_back(InstData(GET_OP(SETLOCAL), slot));
+}
+
+void llama::IRBuilder::_getglobal_slot(int slot) {
+    ops.push_back(InstData(GET_OP(GETGLOBAL_SLOT), slot));
+}
+
+void llama::IRBuilder::_setglobal_slot(int slot) {
+    ops.push_back(InstData(GET_OP(SETGLOBAL_SLOT), slot));
 }
 
 void llama::IRBuilder::_pop() {
@@ -438,36 +459,40 @@ void llama::IRBuilder::_pushobject(std::string class_name) {
     _pushobject(mod->get_constants()->get(class_name));
 }
 
-void llama::IRBuilder::_setglobal(std::string name, int idx) {
-    _setglobal(mod->get_constants()->get(name), idx);
+void llama::IRBuilder::_setglobal(Symbol name, int idx) {
+    _setglobal((int)(mod->get_constants()->get_symbol(name)), idx);
+}
+
+void llama::IRBuilder::_getglobal(Symbol name) {
+    _getglobal((int)(mod->get_constants()->get_symbol(name)));
 }
 
-void llama::IRBuilder::_getglobal(std::string name) {
-    _getglobal(mod->get_constants()->get(name));
+void llama::IRBuilder::_setproperty(Symbol name, int idx) {
+    _setproperty((int)(mod->get_constants()->get_symbol(name)), idx);
 }
 
-void llama::IRBuilder::_setproperty(std::string name, int idx) {
-    _setproperty(mod->get_constants()->get(name), idx);
+void llama::IRBuilder::_getproperty(Symbol name, int idx) {
+    _getproperty((int)(mod->get_constants()->get_symbol(name)), idx);
 }
 
-void llama::IRBuilder::_getproperty(std::string name, int idx) {
-    _getproperty(mod->get_constants()->get(name), idx);
+void llama::IRBuilder::_newglobal(Symbol name) {
+    _newglobal((int)(mod->get_globals()->get(name)));
 }
 
-void llama::IRBuilder::_newglobal(std::string name) {
-    _newglobal(mod->get_constants()->get(name));
+void llama::IRBuilder::_getglobal_slot(Symbol name) {
+    _getglobal_slot((int)(mod->get_globals()->get(name)));
 }
 
-void llama::IRBuilder::_newlocal(std::string name) {
-    _newlocal(mod->get_constants()->get(name));
+void llama::IRBuilder::_setglobal_slot(Symbol name) {
+    _setglobal_slot((int)(mod->get_globals()->get(name)));
 }
 
-void llama::IRBuilder::_refglobal(std::string name) {
-    _refglobal(mod->get_constants()->get(name));
+void llama::IRBuilder::_refglobal(Symbol name) {
+    _refglobal((int)(mod->get_constants()->get_symbol(name)));
 }
 
-void llama::IRBuilder::_refproperty(std::string name) {
-    _refproperty(mod->get_constants()->get(name));
+void llama::IRBuilder::_refproperty(Symbol name) {
+    _refproperty((int)(mod->get_constants()->get_symbol(name)));
 }
 
 void llama::IRBuilder::_typecheck(std::string type) {
@@ -481,8 +506,10 @@ void llama::IRBuilder::push_if() {
 }
 
 void llama::IRBuilder::push_else() {
+    // The IF skips over the whole true branch (ELSE included) when the condition fails
+    ops[blocks.top() - 1].args[0] = size() - blocks.top() + 1;
+
     _else(0);
-    ops.back().args[0] = size() - blocks.top();
 
     blocks.pop();
     blocks.push(size());
@@ -501,7 +528,7 @@ void llama::IRBuilder::push_block() {
 void llama::IRBuilder::end_block() {
     int32_t offset = size() - blocks.top();
 
-    ops.back().args[0] = offset;
+    ops[blocks.top() - 1].args[0] = offset;
 
     _end(-offset);
 
@@ -585,6 +612,10 @@ std::string llama::IRBuilder::disassemble() {
                 else              dis += c->dump();
             }
             dis += ")";
+        } else if (info.flags & GET_FLAG(SLOTARG)) {
+            dis += " (";
+            dis += mod->get_globals()->name(ops[i].args[0]);
+            dis += ")";
         }
 
         dis.push_back('\n');
@@ -605,9 +636,10 @@ void llama::IRBuilder::read(std::vector<unsigned char> & data) {
 size_t llama::IRBuilder::read_inst(std::vector<unsigned char> & data, size_t i) {
     InstData op = InstData(data[i++]);
 
+    // Arguments follow a one byte opcode, so they are never aligned and have to be copied out
     size_t argc = op.get_info().size;
     for (size_t j = 0; j < argc; ++j) {
-        op.args[j] = unpack<int32_t>(data, i);
+        memcpy(&op.args[j], &data[i], sizeof(int32_t));
         i += sizeof(int32_t);
     }
 
@@ -616,6 +648,145 @@ size_t llama::IRBuilder::read_inst(std::vector<unsigned char> & data, size_t i)
     return i;
 }
 
+bool llama::IRBuilder::decode(std::vector<DecodedInst> & code) {
+    // Resolves every block to absolute instruction indexes so the runner never has to walk
+    // over instructions to skip a block, and validates the constant arguments once
+    code.clear();
+    code.reserve(ops.size() + 1);
+
+    size_t count = ops.size();
+
+    // Byte offsets of each instruction, for the relative jumps
+    std::vector<size_t> offsets(count + 1);
+    for (size_t i = 0; i < count; ++i) offsets[i + 1] = offsets[i] + inst_size(ops[i].opcode);
+
+    // Matches each block opener with its ELSE/END (an ELSE is matched with the END), and each END
+    // back with its opener
+    std::vector<size_t> match(count, ERROR_IDX);
+    std::stack<size_t>  openers;
+
+    for (size_t i = 0; i < count; ++i) {
+        switch (ops[i].opcode) {
+            case GET_OP(BLOCK): 
+            case GET_OP(IF): 
+            case GET_OP(LOOP): {
+                openers.push(i);
+                break;
+            }
+            case GET_OP(ELSE): {
+                if (openers.empty() || ops[openers.top()].opcode != GET_OP(IF)) return false;
+                match[openers.top()] = i;
+                openers.pop();
+                openers.push(i);
+                break;
+            }
+            case GET_OP(END): {
+                if (openers.empty()) return false;
+                match[openers.top()] = i;
+                match[i]             = openers.top();
+                openers.pop();
+                break;
+            }
+            default: break;
+        }
+    }
+
+    if (!openers.empty()) return false;
+
+    auto * consts = mod != nullptr ? mod->get_constants() : nullptr;
+
+    std::stack<size_t> loops;
+
+    for (size_t i = 0; i < count; ++i) {
+        InstData & op   = ops[i];
+        InstInfo   info = op.get_info();
+
+        if (info.opcode != op.opcode) return false;
+
+        DecodedInst inst;
+        inst.handler = nullptr;
+        inst.opcode  = op.opcode;
+        inst.target  = i + 1;
+        for (size_t j = 0; j < 3; ++j) inst.args[j] = op.args[j];
+
+        if (info.flags & GET_FLAG(CONSTARG)) {
+            if (consts == nullptr || (size_t)(op.args[0]) >= consts->size()) return false;
+        } else if (info.flags & GET_FLAG(SLOTARG)) {
+            if (mod == nullptr || (size_t)(op.args[0]) >= mod->get_globals()->size()) return false;
+        }
+
+        switch (op.opcode) {
+            case GET_OP(JP): 
+            case GET_OP(JZ): 
+            case GET_OP(JNZ): {
+                size_t byte = offsets[i + 1] + op.args[0];
+                auto   it   = std::lower_bound(offsets.begin(), offsets.end(), byte);
+                if (it == offsets.end() || * it != byte) return false;
+                inst.target = std::distance(offsets.begin(), it);
+                break;
+            }
+            case GET_OP(IF): {
+                // Jumps right after the ELSE or the END when the condition fails
+                inst.target = match[i] + 1;
+                break;
+            }
+            case GET_OP(ELSE): {
+                inst.target = match[i] + 1;
+                break;
+            }
+            case GET_OP(LOOP): {
+                loops.push(i);
+                inst.target = match[i] + 1;
+                break;
+            }
+            case GET_OP(END): {
+                // Only the END of a loop jumps back, every other one just falls through
+                if (ops[match[i]].opcode == GET_OP(LOOP)) {
+                    inst.target = match[i] + 1;
+                    loops.pop();
+                }
+                break;
+            }
+            case GET_OP(REPEAT): {
+                if (loops.empty()) return false;
+                inst.target = loops.top() + 1;
+                break;
+            }
+            case GET_OP(BREAK): {
+                if (loops.empty()) return false;
+                inst.target = match[loops.top()] + 1;
+                break;
+            }
+            case GET_OP(PUSHINT): {
+                // Integers fit right into the instruction, so no constant lookup is needed
+                auto * c = consts->at(op.args[0]);
+                if (c->get_type() != ConstantEntry::Type::Int) return false;
+                inst.args[0] = c->as_int();
+                break;
+            }
+            case GET_OP(PUSHFLOAT): {
+                if (consts->at(op.args[0])->get_type() != ConstantEntry::Type::Float) return false;
+                break;
+            }
+            default: break;
+        }
+
+        code.push_back(inst);
+    }
+
+    // Guarantees the runner can never fall out of the function
+    if (code.empty() || (code.back().opcode != GET_OP(RETURN) && code.back().opcode != GET_OP(RETURNV))) {
+        DecodedInst inst;
+        inst.handler = nullptr;
+        inst.opcode  = GET_OP(RETURNV);
+        inst.target  = code.size() + 1;
+        for (size_t j = 0; j < 3; ++j) inst.args[j] = 0;
+        code.push_back(inst);
+    }
+
+    return true;
+}
+
 void llama::IRBuilder::build(std::vector<unsigned char> & data) {
     data.clear();
     data.reserve(real_size());
@@ -11,86 +11,167 @@
 #include <cstdarg>
 #include <cstring>
 #include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cmath>
 #include <clocale>
 #include <string>
 #include <vector>
 #include <stack>
-#include <map>
+#include <utility>
+#include <algorithm>
+#include <thread>
+
+// Vector scanning of runs needs SSE2 (always there on x86-64), the AVX2 paths are built through
+// GNU target attributes and only picked when the running CPU has it
+#if defined(__GNUC__) && defined(__SSE2__) && !defined(LLAMA_NO_SIMD)
+    #define LLAMA_SIMD
+    #include <immintrin.h>
+#endif
 
 /* -===============
      Internals
    ================- */
 
+// Every keyword and single character operator, the lookup tables below are all generated from these
+#define LLAMA_KEYWORDS(X) \
+    X("not",     Not)     X("or",     Or)     X("and",    And)    X("var",    Var)    \
+    X("let",     Let)     X("const",  Const)  X("extends", Extends) X("if",  If)      \
+    X("else",    Else)    X("for",    For)    X("while",  While)  X("loop",   Loop)   \
+    X("do",      Do)      X("ref",    Ref)    X("as",     As)     X("repeat", Repeat) \
+    X("break",   Break)   X("return", Return) X("null",   Null)   X("true",   True)   \
+    X("false",   False)   X("fn",     Fn)     X("int",    Int)    X("float",  Float)  \
+    X("bool",    Bool)    X("class",  Class)  X("import", Import) X("export", Export)
+
+#define LLAMA_OPERATORS(X) \
+    X("+", Plus)   X("-", Minus)  X("*", Multiply) X("/", Divide)   X("%", Modulo)   \
+    X(",", Comma)  X(":", Colon)  X(".", Dot)      X("(", LParen)   X(")", RParen)   \
+    X("{", LBrace) X("}", RBrace) X("[", LBracket) X("]", RBracket) X(";", End)      \
+    X("!", Not)    X(">", Greater) X("<", Lesser)  X("=", Equal)
+
+// Expands f(0) to f(255), for tables indexed by characters
+#define LLAMA_TABLE4(f, i)   f(i), f(i + 1), f(i + 2), f(i + 3)
+#define LLAMA_TABLE16(f, i)  LLAMA_TABLE4(f, i), LLAMA_TABLE4(f, i + 4), LLAMA_TABLE4(f, i + 8), LLAMA_TABLE4(f, i + 12)
+#define LLAMA_TABLE64(f, i)  LLAMA_TABLE16(f, i), LLAMA_TABLE16(f, i + 16), LLAMA_TABLE16(f, i + 32), LLAMA_TABLE16(f, i + 48)
+#define LLAMA_TABLE256(f)    LLAMA_TABLE64(f, 0), LLAMA_TABLE64(f, 64), LLAMA_TABLE64(f, 128), LLAMA_TABLE64(f, 192)
+
+#define KEYWORD_SLOTS 64 // Size of the keyword hash table, a power of two
+
 namespace llama {
-    static std::map<std::string, Token::Type> keywords = {
-        { "not",      Token::Type::Not      }, 
-        { "or",       Token::Type::Or       }, 
-        { "and",      Token::Type::And      }, 
-        { "var",      Token::Type::Var      }, 
-        { "let",      Token::Type::Let      }, 
-        { "const",    Token::Type::Const    }, 
-        { "extends",  Token::Type::Extends  }, 
-        { "if",       Token::Type::If       }, 
-        { "else",     Token::Type::Else     }, 
-        { "for",      Token::Type::For      }, 
-        { "while",    Token::Type::While    }, 
-        { "loop",     Token::Type::Loop     }, 
-        { "do",       Token::Type::Do       }, 
-        { "ref",      Token::Type::Ref      }, 
-        { "as",       Token::Type::As       }, 
-        { "repeat",   Token::Type::Repeat   }, 
-        { "break",    Token::Type::Break    }, 
-        { "return",   Token::Type::Return   }, 
-        { "null",     Token::Type::Null     }, 
-        { "true",     Token::Type::True     }, 
-        { "false",    Token::Type::False    }, 
-        { "fn",       Token::Type::Fn       }, 
-        { "int",      Token::Type::Int      }, 
-        { "float",    Token::Type::Float    }, 
-        { "bool",     Token::Type::Bool     }, 
-        { "class",    Token::Type::Class    }, 
-        { "import",   Token::Type::Import   }, 
-        { "export",   Token::Type::Export   }, 
+    /* -=- Keywords -=- */
+    struct Keyword {
+        const char * name;
+        size_t       length;
+        Token::Type  type;
     };
 
-    static std::map<Token::Type, std::string> ops = {
-        { Token::Type::Plus,     "+" }, 
-        { Token::Type::Minus,    "-" }, 
-        { Token::Type::Multiply, "*" }, 
-        { Token::Type::Divide,   "/" }, 
-        { Token::Type::Modulo,   "%" }, 
-        { Token::Type::Comma,    "," }, 
-        { Token::Type::Colon,    ":" }, 
-        { Token::Type::Dot,      "." }, 
-        { Token::Type::LParen,   "(" }, 
-        { Token::Type::RParen,   ")" }, 
-        { Token::Type::LBrace,   "{" }, 
-        { Token::Type::RBrace,   "}" }, 
-        { Token::Type::LBracket, "[" }, 
-        { Token::Type::RBracket, "]" }, 
-        { Token::Type::End,      ";" }, 
-        { Token::Type::Not,      "!" }, 
-        { Token::Type::Greater,  ">" }, 
-        { Token::Type::Lesser,   "<" }, 
-        { Token::Type::Equal,    "=" }, 
+    #define LLAMA_KEYWORD_ENTRY(__name, __type) { __name, sizeof(__name) - 1, Token::Type::__type },
+    static constexpr Keyword keyword_list[] = { LLAMA_KEYWORDS(LLAMA_KEYWORD_ENTRY) };
+    #undef LLAMA_KEYWORD_ENTRY
+
+    static constexpr size_t keyword_count = sizeof(keyword_list) / sizeof(Keyword);
+
+    // Perfect hash of the keyword set, only looks at the first and last characters and the length.
+    // If a new keyword collides the static_assert below fails, and the constants have to change
+    static constexpr size_t keyword_hash(const char * s, size_t len) {
+        return ((unsigned char)(s[0]) * 14 + (unsigned char)(s[len - 1]) * 51 + len) & (KEYWORD_SLOTS - 1);
+    }
+
+    static constexpr size_t keyword_hash(size_t i) {
+        return keyword_hash(keyword_list[i].name, keyword_list[i].length);
+    }
+
+    static constexpr bool keyword_unique(size_t i, size_t j) {
+        return j >= keyword_count || (keyword_hash(i) != keyword_hash(j) && keyword_unique(i, j + 1));
+    }
+
+    static constexpr bool keywords_unique(size_t i = 0) {
+        return i >= keyword_count || (keyword_unique(i, i + 1) && keywords_unique(i + 1));
+    }
+
+    static_assert(keywords_unique(), "keyword hash collision, change the constants of keyword_hash()");
+
+    // Index in keyword_list of the keyword hashing to slot, or -1
+    static constexpr int keyword_at(size_t slot, size_t i = 0) {
+        return i >= keyword_count ? -1 : keyword_hash(i) == slot ? (int)(i) : keyword_at(slot, i + 1);
+    }
+
+    static constexpr signed char keyword_slots[KEYWORD_SLOTS] = { LLAMA_TABLE64(keyword_at, 0) };
+
+    static inline Token::Type find_keyword(const char * s, size_t len) {
+        if (len == 0) return Token::Type::Unknown;
+
+        int idx = keyword_slots[keyword_hash(s, len)];
+        if (idx < 0) return Token::Type::Unknown;
+
+        const Keyword & kw = keyword_list[idx];
+        if (kw.length != len || memcmp(kw.name, s, len) != 0) return Token::Type::Unknown;
+        return kw.type;
+    }
+
+    /* -=- Operators -=- */
+    #define LLAMA_OPERATOR_CHAR(__str, __type) __str[0], 
+    #define LLAMA_OPERATOR_TYPE(__str, __type) Token::Type::__type, 
+    static constexpr char        operator_chars[] = { LLAMA_OPERATORS(LLAMA_OPERATOR_CHAR) '\0' };
+    static constexpr Token::Type operator_types[] = { LLAMA_OPERATORS(LLAMA_OPERATOR_TYPE) Token::Type::Unknown };
+    #undef LLAMA_OPERATOR_CHAR
+    #undef LLAMA_OPERATOR_TYPE
+
+    static constexpr Token::Type operator_type(int c, size_t i = 0) {
+        return operator_chars[i] == '\0' ? Token::Type::Unknown : 
+               operator_chars[i] == c ? operator_types[i] : operator_type(c, i + 1);
+    }
+
+    static constexpr Token::Type operator_table[256] = { LLAMA_TABLE256(operator_type) };
+
+    static const char * op_str(Token::Type type) {
+        switch (type) {
+            #define LLAMA_OPERATOR_CASE(__str, __type) case Token::Type::__type: return __str;
+            LLAMA_OPERATORS(LLAMA_OPERATOR_CASE)
+            #undef LLAMA_OPERATOR_CASE
+            default: return "";
+        }
+    }
+
+    /* -=- Character classes -=- */
+    enum CharClass : unsigned char {
+        CharSpace = 1 << 0, 
+        CharDigit = 1 << 1, 
+        CharLabel = 1 << 2, 
+        CharOp    = 1 << 3, 
+        CharStr   = 1 << 4, 
     };
 
+    static constexpr unsigned char char_class(int c) {
+        return (c == ' ' || c == '\t' || c == '\n' || c == '\r'                       ? CharSpace : 0) | 
+               (c >= '0' && c <= '9'                                                 ? CharDigit : 0) | 
+               ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_' || c == '$' ? CharLabel : 0) | 
+               (operator_type(c) != Token::Type::Unknown                             ? CharOp    : 0) | 
+               (c == '\'' || c == '\"' || c == '`'                                    ? CharStr   : 0);
+    }
+
+    static constexpr unsigned char char_classes[256] = { LLAMA_TABLE256(char_class) };
+
+    static inline bool has_class(char c, CharClass cls) {
+        return (char_classes[(unsigned char)(c)] & cls) != 0;
+    }
+
     static inline char to_upper(char c) {
-        if (c >= 'a' && c <= 'z') c += 32;
+        if (c >= 'a' && c <= 'z') c -= 32;
         return c;
     }
 
     static inline char to_lower(char c) {
-        if (c >= 'A' && c <= 'Z') c -= 32;
+        if (c >= 'A' && c <= 'Z') c += 32;
         return c;
     }
 
     static inline bool is_space(char c) {
-        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+        return has_class(c, CharSpace);
     }
 
     static inline bool is_digit(char c) {
-        return c >= '0' && c <= '9';
+        return has_class(c, CharDigit);
     }
 
     static inline bool is_hex(char c) {
@@ -112,13 +193,11 @@ namespace llama {
     }
 
     static inline bool is_op(char c) {
-        return c == '+' || c == '-' || c == '/'  || c == '%' || c == ',' || c == ':' || c == '.' || c == '(' || 
-               c == ')' || c == '{' || c == '}' || c == '['  || c == ']' || c == ';' || c == '*' || c == '!' || 
-               c == '>' || c == '<' || c == '=';
+        return has_class(c, CharOp);
     }
 
     static inline bool is_str(char c) {
-        return c == '\'' || c == '\"' || c == '`';
+        return has_class(c, CharStr);
     }
 
     static inline bool is_literal(char c) {
@@ -127,7 +206,7 @@ namespace llama {
     }
 
     static inline bool is_label(char c) {
-        return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_' || c == '$';
+        return has_class(c, CharLabel);
     }
 
     static inline bool is_ascii(char c) {
@@ -145,9 +224,188 @@ namespace llama {
 
     static inline int hex2int(char c) {
         if (is_digit(c)) return c - '0';
-        if (is_hex(c))   return c - 'a' + 10;
+        if (is_hex(c))   return to_lower(c) - 'a' + 10;
         return -1;
     }
+
+    /* -=- Numbers -=- */
+    // Every power of ten a double holds exactly
+    static constexpr double exact_powers[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11, 
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22, 
+    };
+
+    // Value of the digits of an integer in the given radix, skipping '_' separators. Fails once it
+    // goes over max instead of wrapping around
+    static bool parse_integer(const char * s, size_t len, unsigned radix, uint64_t max, uint64_t & value) {
+        value = 0;
+        for (size_t i = 0; i < len; ++i) {
+            if (s[i] == '_') continue;
+
+            uint64_t digit = hex2int(s[i]);
+            if (value > (max - digit) / radix) return false;
+            value = value * radix + digit;
+        }
+        return true;
+    }
+
+    // Value of a decimal, fails if it's too big for a double. Most literals have few digits and a
+    // small exponent, and those are exact as a 64 bit mantissa times or over an exact power of
+    // ten (the result is rounded only once), the rest go through strtod()
+    static bool parse_decimal(const char * s, size_t len, double & value) {
+        uint64_t mantissa = 0;
+        int      digits   = 0;
+        int      exponent = 0;
+        bool     exact    = true;
+        bool     has_dot  = false;
+
+        size_t i = 0;
+        for (; i < len && to_lower(s[i]) != 'e'; ++i) {
+            if (s[i] == '_') continue;
+            if (s[i] == '.') {
+                has_dot = true;
+                continue;
+            }
+
+            if (mantissa == 0 && s[i] == '0') {
+                // Leading zeros only move the point
+                if (has_dot) --exponent;
+            } else if (digits < 19) {
+                mantissa = mantissa * 10 + (s[i] - '0');
+                ++digits;
+                if (has_dot) --exponent;
+            } else {
+                exact = false;
+                if (!has_dot) ++exponent;
+            }
+        }
+
+        if (i < len) {
+            bool negative = ++i < len && s[i] == '-';
+            if (i < len && is_unary(s[i])) ++i;
+
+            int e = 0;
+            for (; i < len; ++i) {
+                if (s[i] != '_' && e < 100000) e = e * 10 + (s[i] - '0');
+            }
+            exponent += negative ? -e : e;
+        }
+
+        if (exact && mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22) {
+            value = exponent < 0 ? (double)(mantissa) / exact_powers[-exponent] : (double)(mantissa) * exact_powers[exponent];
+            return true;
+        }
+
+        std::string text;
+        text.reserve(len);
+        for (i = 0; i < len; ++i) {
+            if (s[i] != '_') text.push_back(s[i]);
+        }
+
+        errno = 0;
+        value = strtod(text.c_str(), nullptr);
+        return errno != ERANGE || !std::isinf(value);
+    }
+
+    /* -=- Run scanning -=- */
+    // All of these return the position of the first character at or after pos that ends the
+    // run (or len when there's none), the vector versions finish the tail with the scalar ones
+    typedef size_t (* SkipSpaceFn)(const char * s, size_t pos, size_t len);
+    typedef size_t (* FindCharFn)(const char * s, size_t pos, size_t len, char c);
+
+    static size_t skip_space_scalar(const char * s, size_t pos, size_t len) {
+        while (pos < len && is_space(s[pos])) ++pos;
+        return pos;
+    }
+
+    static size_t find_char_scalar(const char * s, size_t pos, size_t len, char c) {
+        while (pos < len && s[pos] != c) ++pos;
+        return pos;
+    }
+
+#ifdef LLAMA_SIMD
+    static size_t skip_space_sse2(const char * s, size_t pos, size_t len) {
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i tab   = _mm_set1_epi8('\t');
+        const __m128i lf    = _mm_set1_epi8('\n');
+        const __m128i cr    = _mm_set1_epi8('\r');
+
+        for (; pos + 16 <= len; pos += 16) {
+            __m128i chunk = _mm_loadu_si128((const __m128i *)(s + pos));
+            __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)), 
+                                         _mm_or_si128(_mm_cmpeq_epi8(chunk, lf),    _mm_cmpeq_epi8(chunk, cr)));
+
+            unsigned mask = ~(unsigned)(_mm_movemask_epi8(match)) & 0xffffu;
+            if (mask != 0) return pos + __builtin_ctz(mask);
+        }
+
+        return skip_space_scalar(s, pos, len);
+    }
+
+    static size_t find_char_sse2(const char * s, size_t pos, size_t len, char c) {
+        const __m128i needle = _mm_set1_epi8(c);
+
+        for (; pos + 16 <= len; pos += 16) {
+            __m128i chunk = _mm_loadu_si128((const __m128i *)(s + pos));
+
+            unsigned mask = (unsigned)(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+            if (mask != 0) return pos + __builtin_ctz(mask);
+        }
+
+        return find_char_scalar(s, pos, len, c);
+    }
+
+    __attribute__((target("avx2")))
+    static size_t skip_space_avx2(const char * s, size_t pos, size_t len) {
+        const __m256i space = _mm256_set1_epi8(' ');
+        const __m256i tab   = _mm256_set1_epi8('\t');
+        const __m256i lf    = _mm256_set1_epi8('\n');
+        const __m256i cr    = _mm256_set1_epi8('\r');
+
+        for (; pos + 32 <= len; pos += 32) {
+            __m256i chunk = _mm256_loadu_si256((const __m256i *)(s + pos));
+            __m256i match = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, space), _mm256_cmpeq_epi8(chunk, tab)), 
+                                            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, lf),    _mm256_cmpeq_epi8(chunk, cr)));
+
+            unsigned mask = ~(unsigned)(_mm256_movemask_epi8(match));
+            if (mask != 0) return pos + __builtin_ctz(mask);
+        }
+
+        return skip_space_sse2(s, pos, len);
+    }
+
+    __attribute__((target("avx2")))
+    static size_t find_char_avx2(const char * s, size_t pos, size_t len, char c) {
+        const __m256i needle = _mm256_set1_epi8(c);
+
+        for (; pos + 32 <= len; pos += 32) {
+            __m256i chunk = _mm256_loadu_si256((const __m256i *)(s + pos));
+
+            unsigned mask = (unsigned)(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+            if (mask != 0) return pos + __builtin_ctz(mask);
+        }
+
+        return find_char_sse2(s, pos, len, c);
+    }
+#endif
+
+    struct Scanner {
+        SkipSpaceFn skip_space;
+        FindCharFn  find_char;
+    };
+
+    static Scanner pick_scanner() {
+#ifdef LLAMA_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return { skip_space_avx2, find_char_avx2 };
+        return { skip_space_sse2, find_char_sse2 };
+#else
+        return { skip_space_scalar, find_char_scalar };
+#endif
+    }
+
+    // Picked once, when the program starts
+    static const Scanner scanner = pick_scanner();
 }
 
 /* -=================
@@ -155,10 +413,13 @@ namespace llama {
    =================- */
 
 /* -=- (Con/des)tructors -=- */
-llama::Token::Token(Type m_type, LogSnippet m_snippet) {
-    lexeme.clear();
-    type    = m_type;
-    snippet = m_snippet;
+llama::Token::Token(Type m_type, uint32_t m_start, uint32_t m_length) {
+    type   = m_type;
+    start  = m_start;
+    length = m_length;
+
+    data.decimal = 0.0;
+    data.symbol  = ERROR_IDX_BIN;
 }
 
 /* -=- Abstractions -=- */
@@ -235,13 +496,18 @@ bool llama::Token::is_decl() {
 }
 
 bool llama::Token::is_empty() {
-    return lexeme.empty() && type == Type::Unknown;
+    return length == 0 && type == Type::Unknown;
 }
 
 /* -=- Utils -=- */
 void llama::Token::clear() {
-    lexeme.clear();
-    type = Type::Unknown;
+    type   = Type::Unknown;
+    length = 0;
+}
+
+llama::LogSnippet llama::Token::snippet() {
+    if (start == UINT32_MAX) return LogSnippet();
+    return LogSnippet(start, length);
 }
 
 int llama::Token::precedence() {
@@ -295,8 +561,6 @@ llama::Token llama::Token::reverse() {
         default: break;
     }
 
-    token.lexeme = ops[token.type];
-
     return token;
 }
 
@@ -375,27 +639,113 @@ const char * llama::Token::type_str() {
 /* -=- (Con/des)tructors -=- */
 llama::Lexer::Lexer() {
     setlocale(LC_ALL, "en_US.UTF-8");
+
+    str_base    = 0;
+    cursor      = 0;
+    file        = nullptr;
+    done        = false;
+    token_base  = 0;
+    released    = 0;
+    batch       = 0;
+    batch_pos   = 0;
+    serial_end  = SIZE_MAX;
+    raw         = false;
+    is_fn       = false;
+    has_pending = false;
+    failed      = false;
+    symbol_pool = nullptr;
 }
 
 llama::Lexer::~Lexer() {
-    tokens.clear();
+    drop_batches();
 }
 
 /* -=- Base functions -=- */
-void llama::Lexer::parse(Logger * m_log, std::string m_str) {
+void llama::Lexer::parse(Logger * m_log, std::string m_str, size_t threads) {
     log = m_log;
-    str = m_str;
+    str = std::move(m_str);
+
+    lines.build(str);
+    log->set_lines(&lines);
+
+    if (str.length() >= UINT32_MAX) {
+        SYNTAXERROR(SourceTooBig, "source too big (%zu bytes)", str.length());
+        done = true;
+        return;
+    }
+
+    types.reserve(std::min(str.length() / 4, (size_t)(LLAMA_LEX_WINDOW * 2)));
+    starts.reserve(types.capacity());
+    lengths.reserve(types.capacity());
+    values.reserve(types.capacity());
+
+    if (threads > 1 && str.length() >= LLAMA_LEX_PARALLEL_MIN) read_parallel(threads);
+}
+
+void llama::Lexer::parse(Logger * m_log, FILE * m_file) {
+    // The file is only read as far as the tokens asked for need it, the caller closes it
+    log  = m_log;
+    file = m_file;
+
+    lines.build(std::string());
+    log->set_lines(&lines);
+}
+
+void llama::Lexer::set_symbols(SymbolPool * m_symbol_pool) {
+    symbol_pool = m_symbol_pool;
+}
+
+size_t llama::Lexer::size() {
+    // Tokens read so far, released ones included
+    return token_base + types.size();
+}
 
-    read_str();
-    refactor();
+bool llama::Lexer::has(size_t pos) {
+    if (pos < token_base) {
+        PANIC(Internal, "token %zu was already released", pos);
+        return false;
+    }
+
+    while (pos >= size()) {
+        if (!read_more()) return false;
+    }
+    return true;
+}
+
+llama::Token llama::Lexer::at(size_t pos) {
+    if (!has(pos)) return Token(Token::Type::Unknown);
+
+    pos -= token_base;
+
+    Token token = Token(types[pos], starts[pos], lengths[pos]);
+    token.data = values[pos];
+    return token;
+}
+
+void llama::Lexer::release(size_t pos) {
+    if (pos > released) released = std::min(pos, size());
+}
+
+std::string llama::Lexer::lexeme(Token token) {
+    // Internal tokens have no text of their own, and strings lose their quotes
+    if (token.start == UINT32_MAX || token.is_internal()) return std::string();
+    if (token.start < str_base) {
+        PANIC(Internal, "text of the token at %zu was already released", (size_t)(token.start));
+        return std::string();
+    }
+
+    size_t pos = token.start - str_base;
+    if (token.type == Token::Type::String) return str.substr(pos + 1, token.length - 2);
+    return str.substr(pos, token.length);
 }
 
 void llama::Lexer::dump() {
-    for (size_t i = 0; i < tokens.size(); ++i) {
-        printf("Token %zu: '%s' (type = %s)\n", i, tokens[i].lexeme.c_str(), tokens[i].type_str());
-        if (tokens[i].type == Token::Type::LBrace) {
+    for (size_t i = token_base; has(i); ++i) {
+        Token token = at(i);
+        printf("Token %zu: '%s' (type = %s)\n", i, lexeme(token).c_str(), token.type_str());
+        if (token.type == Token::Type::LBrace) {
             printf("- Scope start -\n");
-        } else if (tokens[i].type == Token::Type::RBrace || tokens[i].type == Token::Type::End) {
+        } else if (token.type == Token::Type::RBrace || token.type == Token::Type::End) {
             printf("- Scope end -\n");
         }
     }
@@ -403,17 +753,34 @@ void llama::Lexer::dump() {
 }
 
 /* -=- Primitive search -=- */
-void llama::Lexer::read_str() {
-    // Reads the input appropriately
-    size_t i = 0;
-    while (i < str.length()) {
+bool llama::Lexer::read_more() {
+    // Reads the input appropriately, until at least one more token is out (a lexeme doesn't always
+    // give one right away) or there's nothing left to read
+    size_t count = types.size();
+    while (types.size() == count) {
+        if (done) return false;
+
+        compact();
+
+        if (batch < batches.size() && cursor >= serial_end) {
+            read_batch();
+            if (failed) done = true;
+            continue;
+        }
+
+        size_t i = cursor;
+        if (!more(i)) {
+            read_end();
+            continue;
+        }
+
         // Avoids infinite loops
         size_t old_i = i;
 
         char c = str[i];
         if (is_space(c)) {
             // Checkes for whitespaces
-            ++i;
+            cursor = skip_space(i + 1);
             continue;
         } else if (is_comment(c) && (seek(i + 1) == '*' || seek(i + 1) == '/')) {
             // Checkes for comments
@@ -432,21 +799,202 @@ void llama::Lexer::read_str() {
             i = read_label(i);
         } else {
             // If any of the options didn't match
-            log->set_snippet(LogSnippet(str, i));
-            SYNTAXERROR("unexpected character %c", c);
+            log->set_snippet(LogSnippet(str_base + i));
+            SYNTAXERROR(UnexpectedCharacter, "unexpected character %c", c);
             i = ERROR_IDX;
         }
 
         if (i == old_i) {
-            log->set_snippet(LogSnippet(str, i));
-            SYNTAXERROR("infinite loop, aborting");
-            break;
-        } else if (i == ERROR_IDX) {
+            log->set_snippet(LogSnippet(str_base + i));
+            SYNTAXERROR(Internal, "infinite loop, aborting");
+            read_end();
+        } else if (i == ERROR_IDX || failed) {
+            done = true;
+        } else {
+            cursor = i;
+        }
+    }
+
+    return true;
+}
+
+void llama::Lexer::read_batch() {
+    // Waits for the chunk to be lexed (the ones after it keep going meanwhile), then hands its
+    // tokens over until one more is out
+    Batch & current = batches[batch];
+    if (current.thread.joinable()) current.thread.join();
+
+    Lexer * chunk = current.lexer;
+    size_t  count = types.size();
+    while (batch_pos < chunk->types.size() && types.size() == count && !failed) {
+        Token token = Token(chunk->types[batch_pos], chunk->starts[batch_pos], chunk->lengths[batch_pos]);
+        token.data = chunk->values[batch_pos];
+        hold(token);
+        ++batch_pos;
+    }
+    if (types.size() != count || failed) return;
+
+    // Used up, a chunk that stopped at an error hands over to the serial reader right at that
+    // lexeme, so that the error is reported the same way and after everything before it
+    cursor = chunk->str_base + chunk->cursor - str_base;
+    if (current.log->has_error()) {
+        drop_batches();
+        return;
+    }
+
+    delete current.lexer;
+    delete current.log;
+    current.lexer = nullptr;
+    current.log   = nullptr;
+
+    batch_pos = 0;
+    if (++batch >= batches.size()) batches.clear();
+}
+
+void llama::Lexer::drop_batches() {
+    for (Batch & current : batches) {
+        if (current.thread.joinable()) current.thread.join();
+        delete current.lexer;
+        delete current.log;
+    }
+    batches.clear();
+}
+
+void llama::Lexer::read_parallel(size_t threads) {
+    // Lexes every chunk but the first on its own thread, without refactoring (that carries state
+    // from one token to the next, so it's left to read_batch() going over them in order). The
+    // first chunk is read here as usual, while the others are being lexed
+    std::vector<size_t> bounds = split(threads);
+    if (bounds.size() < 2) return;
+
+    serial_end = bounds[1];
+    batches.resize(bounds.size() - 1);
+
+    for (size_t i = 0; i < batches.size(); ++i) {
+        size_t start = bounds[i + 1];
+        size_t end   = i + 2 < bounds.size() ? bounds[i + 2] : str.length();
+
+        // Set up here since the constructor touches the locale, which isn't thread safe
+        Lexer * chunk = new Lexer();
+        chunk->log      = new Logger();
+        chunk->raw      = true;
+        chunk->str      = str.substr(start, end - start);
+        chunk->str_base = start;
+        chunk->types.reserve((end - start) / 4);
+        chunk->starts.reserve((end - start) / 4);
+        chunk->lengths.reserve((end - start) / 4);
+        chunk->values.reserve((end - start) / 4);
+        chunk->log->set_muted();
+
+        batches[i].lexer  = chunk;
+        batches[i].log    = chunk->log;
+        batches[i].thread = std::thread([chunk]() {
+            while (chunk->read_more()) {}
+        });
+    }
+}
+
+std::vector<size_t> llama::Lexer::split(size_t count) {
+    // Starts of up to count chunks of about the same size, each right after a newline that isn't
+    // inside a string or a comment (no lexeme can go over one of those)
+    std::vector<size_t> bounds(1, 0);
+
+    size_t step = str.length() / count;
+    size_t next = step;
+
+    size_t i = 0;
+    while (i < str.length() && bounds.size() < count) {
+        char c = str[i];
+        if (is_str(c)) {
+            i = find_char(i + 1, c) + 1;
+        } else if (is_comment(c) && seek(i + 1) == '/') {
+            i = find_char(i + 2, '\n');
+        } else if (is_comment(c) && seek(i + 1) == '*') {
+            for (i = find_char(i + 2, '*'); more(i) && seek(i + 1) != '/'; i = find_char(i + 1, '*')) {}
+            i += 2;
+        } else {
+            if (c == '\n' && i + 1 >= next && i + 1 < str.length()) {
+                bounds.push_back(i + 1);
+                next = i + 1 + step;
+            }
+            ++i;
+        }
+    }
+
+    return bounds;
+}
+
+void llama::Lexer::read_end() {
+    done = true;
+
+    // The last token is only refactored once it's known that nothing follows it
+    if (has_pending) refactor(pending, Token(Token::Type::Unknown));
+    has_pending = false;
+    if (failed) return;
+
+    if (expects.size() > 0) {
+        log->set_snippet(expects.top().snippet());
+        SYNTAXERROR(UnmatchedToken, "unmatched token '%s'", op_str(expects.top().reverse().type));
+    }
+}
+
+void llama::Lexer::read_chunk(size_t pos) {
+    // Loads chunks of the file until pos is in
+    while (file != nullptr && pos >= str.length()) {
+        size_t old_len = str.length();
+
+        str.resize(old_len + LLAMA_LEX_CHUNK);
+        size_t count = fread(&str[old_len], sizeof(char), LLAMA_LEX_CHUNK, file);
+        str.resize(old_len + count);
+
+        if (count == 0) {
+            file = nullptr;
             break;
         }
+
+        lines.extend(str.data() + old_len, count, str_base + old_len);
+
+        if (str_base + str.length() >= UINT32_MAX) {
+            SYNTAXERROR(SourceTooBig, "source too big (over %zu bytes)", str_base + str.length());
+            file = nullptr;
+            done = true;
+            str.resize(old_len);
+        }
     }
 }
 
+void llama::Lexer::compact() {
+    // Drops released tokens once enough of them piled up, moving the rest of the window back
+    if (released - token_base >= LLAMA_LEX_WINDOW) {
+        size_t count = released - token_base;
+        types.erase(types.begin(), types.begin() + count);
+        starts.erase(starts.begin(), starts.begin() + count);
+        lengths.erase(lengths.begin(), lengths.begin() + count);
+        values.erase(values.begin(), values.begin() + count);
+        token_base = released;
+    }
+
+    // Then the source text before the first token that still needs it (strings given at once are
+    // kept as is, there's nothing to save there)
+    if (file == nullptr || cursor < LLAMA_LEX_CHUNK) return;
+
+    size_t keep = std::min(cursor, str.length());
+    if (has_pending) keep = std::min(keep, (size_t)(pending.start) - str_base);
+    for (size_t i = released - token_base; i < types.size(); ++i) {
+        // Text bearing tokens come in order, so the first one is the oldest
+        Token token = Token(types[i], starts[i], lengths[i]);
+        if (token.start == UINT32_MAX || token.is_internal()) continue;
+        keep = std::min(keep, (size_t)(token.start) - str_base);
+        break;
+    }
+
+    if (keep < LLAMA_LEX_CHUNK) return;
+
+    str.erase(0, keep);
+    str_base += keep;
+    cursor   -= keep;
+}
+
 size_t llama::Lexer::read_comment(size_t start) {
     size_t i = start + 2;
 
@@ -455,12 +1003,13 @@ size_t llama::Lexer::read_comment(size_t start) {
     bool mlined  = (str[start] == '/' && seek(start + 1) == '*');
     bool has_end = false;
 
-    // Seeks for a comment (pretty much the same logic as the read_string() function)
-    while (i < str.length()) {
-        bool single_end = (lined  && str[i] == '\n');
-        bool multi_end  = (mlined && str[i] == '*' && seek(i + 1) == '/');
+    // Seeks for a comment (pretty much the same logic as the read_string() function), multiline
+    // ones jump from one '*' to the next until it's followed by a '/'
+    while (more(i)) {
+        i = find_char(i, lined ? '\n' : '*');
+        if (!more(i)) break;
 
-        if (single_end || multi_end) {
+        if (lined || seek(i + 1) == '/') {
             has_end = true;
             break;
         }
@@ -471,8 +1020,8 @@ size_t llama::Lexer::read_comment(size_t start) {
     if (lined) has_end = true;
 
     if (!has_end) {
-        log->set_snippet(LogSnippet(str, start));
-        SYNTAXERROR("unterminated comment");
+        log->set_snippet(LogSnippet(str_base + start));
+        SYNTAXERROR(UnterminatedComment, "unterminated comment");
         return ERROR_IDX;
     }
 
@@ -490,25 +1039,16 @@ size_t llama::Lexer::read_string(size_t start) {
     bool has_end = false;
 
     // Seeks for a string until it ends
-    while (i < str.length()) {
-        if (str[i] == first) {
-            // If the string has ended
-            has_end = true;
-            break;
-        }
-
-        token.lexeme.push_back(str[i]);
-
-        ++i;
-    }
+    i = find_char(i, first);
+    if (more(i)) has_end = true;
 
     if (!has_end) {
-        log->set_snippet(LogSnippet(str, start));
-        SYNTAXERROR("unterminated string");
+        log->set_snippet(LogSnippet(str_base + start));
+        SYNTAXERROR(UnterminatedString, "unterminated string");
         return ERROR_IDX;
     }
 
-    push(start, token);
+    push(start, i + 1, token);
 
     return i + 1;
 }
@@ -516,42 +1056,64 @@ size_t llama::Lexer::read_string(size_t start) {
 size_t llama::Lexer::read_number(size_t start) {
     Token token = Token(Token::Type::Integer);
 
-    size_t end = start;
+    size_t   end   = start;
+    unsigned radix = 10;
 
     // Checkes if the number is a literal or a decimal number
     char lit = seek(start + 1);
     if (str[start] == '0' && is_literal(lit)) {
-        switch (lit) {
+        switch (to_lower(lit)) {
             case 'x': {
-                end = search_hexadecimal(start + 2);
+                end   = search_hexadecimal(start + 2);
+                radix = 16;
                 break;
             }
             case 'o': {
-                end = search_octal(start + 2);
+                end   = search_octal(start + 2);
+                radix = 8;
                 break;
             }
             case 'b': {
-                end = search_binary(start + 2);
+                end   = search_binary(start + 2);
+                radix = 2;
                 break;
             }
             default: {
-                log->set_snippet(LogSnippet(str, start + 1));
-                SYNTAXERROR("invalid literal %c", lit);
+                log->set_snippet(LogSnippet(str_base + start + 1));
+                SYNTAXERROR(MalformedNumber, "invalid literal %c", lit);
                 return ERROR_IDX;
             }
         }
     } else {
-        bool has_dot = false;
-        end = search_decimal(start, has_dot);
-        if (has_dot) token.type = Token::Type::Decimal;
+        bool is_decimal = false;
+        end = search_decimal(start, is_decimal);
+        if (is_decimal) token.type = Token::Type::Decimal;
     }
 
     // Check for errors
-    if (end != ERROR_IDX && end > start) {
-        token.lexeme = str.substr(start, end - start);
-        push(start, token);
+    if (end == ERROR_IDX || end <= start) return end;
+
+    // The value is worked out once here, the analyser takes it straight from the token. Literals in
+    // other radixes are bit patterns, so they can use up all 32 bits
+    if (token.type == Token::Type::Decimal) {
+        if (!parse_decimal(str.data() + start, end - start, token.data.decimal)) {
+            log->set_snippet(LogSnippet(str_base + start, end - start));
+            SYNTAXERROR(NumberOutOfRange, "decimal number out of range");
+            return ERROR_IDX;
+        }
+    } else {
+        size_t   digits = radix == 10 ? start : start + 2;
+        uint64_t value  = 0;
+        if (!parse_integer(str.data() + digits, end - digits, radix, radix == 10 ? INT_MAX : UINT32_MAX, value)) {
+            log->set_snippet(LogSnippet(str_base + start, end - start));
+            SYNTAXERROR(NumberOutOfRange, "integer number out of range");
+            return ERROR_IDX;
+        }
+        token.data.integer = (int)((uint32_t)(value));
     }
 
+    push(start, end, token);
+
     return end;
 }
 
@@ -562,30 +1124,7 @@ size_t llama::Lexer::read_op(size_t start) {
     
     // Checkes for operators
     char c = str[i];
-    switch (c) {
-        case '+': { token.type = Token::Type::Plus;     break; }
-        case '-': { token.type = Token::Type::Minus;    break; }
-        case '*': { token.type = Token::Type::Multiply; break; }
-        case '/': { token.type = Token::Type::Divide;   break; }
-        case '%': { token.type = Token::Type::Modulo;   break; }
-        case ',': { token.type = Token::Type::Comma;    break; }
-        case ':': { token.type = Token::Type::Colon;    break; }
-        case '.': { token.type = Token::Type::Dot;      break; }
-        case '(': { token.type = Token::Type::LParen;   break; }
-        case ')': { token.type = Token::Type::RParen;   break; }
-        case '{': { token.type = Token::Type::LBrace;   break; }
-        case '}': { token.type = Token::Type::RBrace;   break; }
-        case '[': { token.type = Token::Type::LBracket; break; }
-        case ']': { token.type = Token::Type::RBracket; break; }
-        case ';': { token.type = Token::Type::End;      break; }
-        case '!': { token.type = Token::Type::Not;      break; }
-        case '>': { token.type = Token::Type::Greater;  break; }
-        case '<': { token.type = Token::Type::Lesser;   break; }
-        case '=': { token.type = Token::Type::Equal;    break; }
-        default: break;
-    }
-
-    token.lexeme.push_back(c);
+    token.type = operator_table[(unsigned char)(c)];
 
     char lc = seek(i + 1);
     if (is_op(lc)) {
@@ -594,7 +1133,6 @@ size_t llama::Lexer::read_op(size_t start) {
                 if (c == '*') token.type = Token::Type::Power;
                 else break;
                 
-                token.lexeme.push_back(lc);
                 ++i;
                 break;
             }
@@ -605,7 +1143,6 @@ size_t llama::Lexer::read_op(size_t start) {
                 else if (c == '!') token.type = Token::Type::NotEquals;
                 else break;
                 
-                token.lexeme.push_back(lc);
                 ++i;
                 break;
             }
@@ -614,12 +1151,12 @@ size_t llama::Lexer::read_op(size_t start) {
     }
     
     if (token.type == Token::Type::Unknown) {
-        log->set_snippet(LogSnippet(str, i));
-        SYNTAXERROR("unknown operator %c", c);
+        log->set_snippet(LogSnippet(str_base + i));
+        SYNTAXERROR(UnknownOperator, "unknown operator %c", c);
         return ERROR_IDX;
     }
 
-    push(start, token);
+    push(start, i + 1, token);
 
     return i + 1;
 }
@@ -630,10 +1167,9 @@ size_t llama::Lexer::read_label(size_t start) {
     size_t i = start;
     
     // Checkes for labels
-    while (i < str.length()) {
+    while (more(i)) {
         if (is_label(str[i]) || is_digit(str[i])) {
             // Handles labels
-            token.lexeme.push_back(str[i]);
             ++i;
             continue;
         } else if (is_space(str[i]) || is_op(str[i])) {
@@ -641,38 +1177,39 @@ size_t llama::Lexer::read_label(size_t start) {
             break;
         } else if (!is_ascii(str[i])) {
             // In case a unicode character is found
-            log->set_snippet(LogSnippet(str, start));
-            SYNTAXERROR("special UTF-8 characters are not allowed for labels");
+            log->set_snippet(LogSnippet(str_base + start));
+            SYNTAXERROR(UnexpectedCharacter, "special UTF-8 characters are not allowed for labels");
             return ERROR_IDX;
         } else {
             // In case any of the conditions are not met properly
-            log->set_snippet(LogSnippet(str, i));
-            SYNTAXERROR("unexpected character '%c' in label", str[i]);
+            log->set_snippet(LogSnippet(str_base + i));
+            SYNTAXERROR(UnexpectedCharacter, "unexpected character '%c' in label", str[i]);
             return ERROR_IDX;
         }
     }
 
-    push(start, token);
+    push(start, i, token);
 
     return i;
 }
 
 /* -=- Deep index-oriented search -=- */
-size_t llama::Lexer::search_decimal(size_t start, bool & has_dot) {
+size_t llama::Lexer::search_decimal(size_t start, bool & is_decimal) {
     size_t i = start;
 
     // Number flags
+    bool has_dot = false;
     bool has_e   = false;
     bool has_end = false;
     bool has_sig = false;
 
     // Searches for the last character of a decimal number
-    while (i < str.length()) {
+    while (more(i)) {
         if (is_unary(str[i]) && has_e) {
             // Handles unary numbers for the e-notation exponent
             if (has_sig) {
-                log->set_snippet(LogSnippet(str, i));
-                SYNTAXERROR("duplicated signal on e-notation exponent");
+                log->set_snippet(LogSnippet(str_base + i));
+                SYNTAXERROR(MalformedNumber, "duplicated signal on e-notation exponent");
                 return ERROR_IDX;
             } else {
                 has_sig = true;
@@ -692,36 +1229,38 @@ size_t llama::Lexer::search_decimal(size_t start, bool & has_dot) {
         } else if (to_lower(str[i]) == 'e') {
             // Handles the e-notation marker
             if (has_e) {
-                log->set_snippet(LogSnippet(str, i));
-                SYNTAXERROR("duplicated e-notation marker in number");
+                log->set_snippet(LogSnippet(str_base + i));
+                SYNTAXERROR(MalformedNumber, "duplicated e-notation marker in number");
                 return ERROR_IDX;
             } else {
-                has_e = true;
+                has_e      = true;
+                is_decimal = true;
                 ++i;
                 continue;
             }
         } else if (str[i] == '.') {
             // Handles decimal numbers
             if (has_e) {
-                log->set_snippet(LogSnippet(str, i));
-                SYNTAXERROR("decimal number on e-notation exponent");
+                log->set_snippet(LogSnippet(str_base + i));
+                SYNTAXERROR(MalformedNumber, "decimal number on e-notation exponent");
                 return ERROR_IDX;
             }
 
             if (has_dot) {
-                log->set_snippet(LogSnippet(str, i));
-                SYNTAXERROR("duplicated dot in number");
+                log->set_snippet(LogSnippet(str_base + i));
+                SYNTAXERROR(MalformedNumber, "duplicated dot in number");
                 return ERROR_IDX;
             } else {
-                has_dot = true;
+                has_dot    = true;
+                is_decimal = true;
                 ++i;
                 continue;
             }
         } else if (is_space(str[i]) || is_op(str[i])) {
             // Checkes if the e-notation number ended properly if it exists
             if (has_e && !has_end) {
-                log->set_snippet(LogSnippet(str, i));
-                SYNTAXERROR("invalid e-notation exponent");
+                log->set_snippet(LogSnippet(str_base + i));
+                SYNTAXERROR(MalformedNumber, "invalid e-notation exponent");
                 return ERROR_IDX;
             }
 
@@ -729,8 +1268,8 @@ size_t llama::Lexer::search_decimal(size_t start, bool & has_dot) {
             break;
         } else {
             // In case any of the conditions are not met properly
-            log->set_snippet(LogSnippet(str, i));
-            SYNTAXERROR("malformed number");
+            log->set_snippet(LogSnippet(str_base + i));
+            SYNTAXERROR(MalformedNumber, "malformed number");
             return ERROR_IDX;
         }
     }
@@ -742,7 +1281,7 @@ size_t llama::Lexer::search_hexadecimal(size_t start) {
     size_t i = start;
 
     // Searches for the last character of a hexadecimal number
-    while (i < str.length()) {
+    while (more(i)) {
         if (is_hexdigit(str[i]) || str[i] == '_') {
             // Handles digits and the '_' number separator
             ++i;
@@ -752,8 +1291,8 @@ size_t llama::Lexer::search_hexadecimal(size_t start) {
             break;
         } else {
             // In case any of the conditions are not met properly
-            log->set_snippet(LogSnippet(str, i));
-            SYNTAXERROR("hexadecimal number containing non-hexadecimal character %c", str[i]);
+            log->set_snippet(LogSnippet(str_base + i));
+            SYNTAXERROR(MalformedNumber, "hexadecimal number containing non-hexadecimal character %c", str[i]);
             return ERROR_IDX;
         }
     }
@@ -765,7 +1304,7 @@ size_t llama::Lexer::search_octal(size_t start) {
     size_t i = start;
 
     // Searches for the last character of a hexadecimal number
-    while (i < str.length()) {
+    while (more(i)) {
         if (is_octal(str[i]) || str[i] == '_') {
             // Handles digits and the '_' number separator
             ++i;
@@ -775,8 +1314,8 @@ size_t llama::Lexer::search_octal(size_t start) {
             break;
         } else {
             // In case any of the conditions are not met properly
-            log->set_snippet(LogSnippet(str, i));
-            SYNTAXERROR("octal number containing non-octal character %c", str[i]);
+            log->set_snippet(LogSnippet(str_base + i));
+            SYNTAXERROR(MalformedNumber, "octal number containing non-octal character %c", str[i]);
             return ERROR_IDX;
         }
     }
@@ -788,7 +1327,7 @@ size_t llama::Lexer::search_binary(size_t start) {
     size_t i = start;
 
     // Searches for the last character of a hexadecimal number
-    while (i < str.length()) {
+    while (more(i)) {
         if (is_binary(str[i]) || str[i] == '_') {
             // Handles digits and the '_' number separator
             ++i;
@@ -798,8 +1337,8 @@ size_t llama::Lexer::search_binary(size_t start) {
             break;
         } else {
             // In case any of the conditions are not met properly
-            log->set_snippet(LogSnippet(str, i));
-            SYNTAXERROR("binary number containing non-binary character %c", str[i]);
+            log->set_snippet(LogSnippet(str_base + i));
+            SYNTAXERROR(MalformedNumber, "binary number containing non-binary character %c", str[i]);
             return ERROR_IDX;
         }
     }
@@ -808,102 +1347,139 @@ size_t llama::Lexer::search_binary(size_t start) {
 }
 
 /* -=- Refactoring -=- */
-void llama::Lexer::refactor() {
-    // Scans for HEAVILY specific errors so the analyser receives something that makes sense
-    std::stack<Token> expects;
-
-    Token last;
-
-    bool is_fn = false;
-
-    // First iteration
-    size_t i = 0;
-    while (i < tokens.size()) {
-        Token token = tokens[i];
-
-        if (token.is_internal()) {
-            ++i;
-            continue;
-        }
-
-        if (token.type == Token::Type::Label && keywords.find(token.lexeme) != keywords.end()) {
-            token.type = keywords[token.lexeme];
-            if (token.type == Token::Type::Fn) is_fn = true;
-        }
-
-        if (!is_fn && token.is_callable() && seek_token(i + 1).type == Token::Type::LParen) {
-            tokens.insert(tokens.begin() + i + 1, Token(Token::Type::CallStart, token.snippet));
-            expects.push(Token(Token::Type::CallEnd, token.snippet));
-        }
-
-        // printf("going... token '%s' found at %zu (last '%s', type = %s)\n", token.lexeme.c_str(), i, last.lexeme.c_str(), last.type_str());
-
-        if (token.is_op() && seek_token(i + 1).is_operand() && !seek_token(i - 1).is_operand()) {
-            if (token.type == Token::Type::Plus) {
-                token.type = Token::Type::UnaryPlus;
-            } else if (token.type == Token::Type::Minus) {
-                token.type = Token::Type::UnaryMinus;
-            }
+void llama::Lexer::refactor(Token token, Token next) {
+    // Scans for HEAVILY specific errors so the analyser receives something that makes sense. Runs
+    // on every token as soon as the one after it was read, so the stream is refactored in one pass
+    if (token.type == Token::Type::Fn) is_fn = true;
+
+    bool call_start = !is_fn && token.is_callable() && next.type == Token::Type::LParen;
+    bool call_end   = false;
+
+    if (call_start) expects.push(Token(Token::Type::CallEnd, token.start, token.length));
+
+    // The previous token is the last refactored one, call markers included
+    if (token.is_op() && (next.is_operand() || next.type == Token::Type::LParen) && !prev.is_operand()) {
+        if (token.type == Token::Type::Plus) {
+            token.type = Token::Type::UnaryPlus;
+        } else if (token.type == Token::Type::Minus) {
+            token.type = Token::Type::UnaryMinus;
         }
+    }
 
-        if (token.is_expr() && (last.is_arithmetic() || last.is_special())) {
-            log->set_snippet(token.snippet);
-            SYNTAXERROR("unexpected operator '%s'", token.lexeme.c_str());
-            return;
-        } else if (token.is_lscope()) {
-            expects.push(token.reverse());
-            is_fn = false;
-        } else if (token.is_rscope()) {
-            if (expects.size() > 0) {
-                if (expects.top().type == token.type) {
-                    expects.pop();
-                } else {
-                    log->set_snippet(token.snippet);
-                    SYNTAXERROR("unexpected token '%s', expected '%s'", token.lexeme.c_str(), ops[expects.top().type].c_str());
-                    return;
-                }
+    if (token.is_expr() && !token.is_unary() && (last.is_arithmetic() || last.is_special())) {
+        log->set_snippet(token.snippet());
+        SYNTAXERROR(UnexpectedToken, "unexpected operator '%s'", lexeme(token).c_str());
+        failed = true;
+        return;
+    } else if (token.is_lscope()) {
+        expects.push(token.reverse());
+        is_fn = false;
+    } else if (token.is_rscope()) {
+        if (expects.size() > 0) {
+            if (expects.top().type == token.type) {
+                expects.pop();
             } else {
-                log->set_snippet(token.snippet);
-                SYNTAXERROR("unmatched token '%s'");
+                log->set_snippet(token.snippet());
+                SYNTAXERROR(UnexpectedToken, "unexpected token '%s', expected '%s'", lexeme(token).c_str(), op_str(expects.top().type));
+                failed = true;
                 return;
             }
-
-            if (expects.size() > 0 && expects.top().type == Token::Type::CallEnd) {
-                tokens.insert(tokens.begin() + i + 1, expects.top());
-                expects.pop();
-            }
+        } else {
+            log->set_snippet(token.snippet());
+            SYNTAXERROR(UnmatchedToken, "unmatched token '%s'", lexeme(token).c_str());
+            failed = true;
+            return;
         }
 
-        if (!token.is_internal()) last = token;
-
-        tokens[i] = token;
-
-        ++i;
+        call_end = expects.size() > 0 && expects.top().type == Token::Type::CallEnd;
     }
 
-    if (expects.size() > 0) {
-        log->set_snippet(expects.top().snippet);
-        SYNTAXERROR("unmatched token '%s'", expects.top().reverse().lexeme.c_str());
+    last = token;
+
+    append(token);
+    if (call_start) append(Token(Token::Type::CallStart, token.start, token.length));
+    if (call_end) {
+        append(expects.top());
+        expects.pop();
     }
 }
 
 /* -=- String and token management -=- */
+bool llama::Lexer::more(size_t pos) {
+    // Whether pos is in the source, loading it first if it's still in the file
+    if (pos < str.length()) return true;
+
+    read_chunk(pos);
+    return pos < str.length();
+}
+
 char llama::Lexer::seek(size_t pos) {
     // Seeks for characters that can be also AHEAD of the size of the string
     // NOTE: doing this because it reduces code + makes more idiotic and focused on what really matters
-    if (pos >= str.length()) return '\0';
+    if (!more(pos)) return '\0';
     return str[pos];
 }
 
+size_t llama::Lexer::skip_space(size_t pos) {
+    // Same as the scanners, going on through the next chunks when the run reaches the end
+    while (more(pos)) {
+        pos = scanner.skip_space(str.data(), pos, str.length());
+        if (pos < str.length()) break;
+    }
+    return pos;
+}
+
+size_t llama::Lexer::find_char(size_t pos, char c) {
+    while (more(pos)) {
+        pos = scanner.find_char(str.data(), pos, str.length(), c);
+        if (pos < str.length()) break;
+    }
+    return pos;
+}
+
 llama::Token llama::Lexer::seek_token(size_t pos) {
     // Does the exact same as the seek() function but for tokens
-    if (pos >= tokens.size()) return Token(Token::Type::Unknown);
-    return tokens[pos];
+    if (!has(pos)) return Token(Token::Type::Unknown);
+    return at(pos);
+}
+
+void llama::Lexer::push(size_t start, size_t end, Token token) {
+    token.start  = str_base + start;
+    token.length = end - start;
+    if (token.is_empty()) return;
+
+    if (token.type == Token::Type::Label) {
+        Token::Type keyword = find_keyword(str.data() + start, end - start);
+        if (keyword != Token::Type::Unknown) token.type = keyword;
+    }
+
+    hold(token);
 }
 
-void llama::Lexer::push(size_t pos, Token token) {
-    if (!token.is_empty()) {
-        token.snippet = LogSnippet(str, pos);
-        tokens.push_back(token);
+void llama::Lexer::hold(Token token) {
+    if (raw) {
+        append(token);
+        return;
     }
+
+    // Tokens are held back by one, refactoring them needs the next one
+    if (has_pending) refactor(pending, token);
+
+    pending     = token;
+    has_pending = true;
+}
+
+void llama::Lexer::append(Token token) {
+    // Labels are interned once here, everything after the lexer only sees their symbol (raw chunks
+    // leave it to the lexer they're handed over to)
+    if (token.type == Token::Type::Label && symbol_pool != nullptr && !raw) {
+        token.data.symbol = symbol_pool->get(str.data() + (token.start - str_base), token.length);
+    }
+
+    prev = token;
+
+    types.push_back(token.type);
+    starts.push_back(token.start);
+    lengths.push_back(token.length);
+    values.push_back(token.data);
 }
\ No newline at end of file
@@ -0,0 +1,159 @@
+/* -=============
+     Includes
+   =============- */
+
+#include <log_sink.h>
+#include <error.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/* -==================
+     LogSink class
+   ==================- */
+
+/* -=- (Con/des)tructors -=- */
+llama::LogSink::LogSink(size_t m_capacity, LogFn m_log_fn) {
+    // Positions are masked into the slots, so the capacity is rounded up to a power of two
+    size_t capacity = 2;
+    while (capacity < m_capacity) capacity <<= 1;
+
+    slots = new Slot[capacity];
+    mask  = capacity - 1;
+    for (size_t i = 0; i < capacity; ++i) slots[i].seq.store(i, std::memory_order_relaxed);
+
+    head.store(0);
+    tail.store(0);
+    drops.store(0);
+    writes.store(0);
+
+    log_fn = m_log_fn;
+
+    sleeping.store(false);
+    stopping.store(false);
+    consumer.store(std::thread::id());
+
+    thread = std::thread([this]() { consume(); });
+}
+
+llama::LogSink::~LogSink() {
+    // Everything pushed before is still written
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping.store(true);
+    }
+    wake.notify_one();
+    thread.join();
+
+    delete[] slots;
+}
+
+/* -=- Queue -=- */
+bool llama::LogSink::push(const Logger::Diagnostic & diag) {
+    size_t pos = head.load(std::memory_order_relaxed);
+
+    Slot * slot;
+    while (true) {
+        slot = &slots[pos & mask];
+
+        size_t   seq  = slot->seq.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)(seq) - (intptr_t)(pos);
+
+        if (diff == 0) {
+            if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            // The consumer hasn't read the slot from the last round yet
+            drops.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = head.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->diag = diag;
+    slot->seq.store(pos + 1, std::memory_order_release);
+
+    if (sleeping.load(std::memory_order_acquire)) wake.notify_one();
+
+    return true;
+}
+
+bool llama::LogSink::pop(Logger::Diagnostic & diag) {
+    size_t pos  = tail.load(std::memory_order_relaxed);
+    Slot * slot = &slots[pos & mask];
+
+    if (slot->seq.load(std::memory_order_acquire) != pos + 1) return false;
+
+    diag = slot->diag;
+    slot->seq.store(pos + mask + 1, std::memory_order_release);
+    tail.store(pos + 1, std::memory_order_release);
+
+    return true;
+}
+
+void llama::LogSink::flush() {
+    // Waits for whatever was pushed so far, for the logs that have to be out before exiting
+    size_t pos = head.load(std::memory_order_acquire);
+
+    // The consumer would be waiting on itself, so it writes them right away instead
+    if (std::this_thread::get_id() == consumer.load(std::memory_order_acquire)) {
+        Logger::Diagnostic diag;
+        while (tail.load(std::memory_order_relaxed) < pos) {
+            if (!pop(diag)) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            Logger::print(diag, log_fn);
+            writes.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+
+    while (tail.load(std::memory_order_acquire) < pos) {
+        wake.notify_one();
+        std::this_thread::yield();
+    }
+}
+
+void llama::LogSink::consume() {
+    consumer.store(std::this_thread::get_id(), std::memory_order_release);
+
+    Logger::Diagnostic diag;
+
+    while (true) {
+        while (pop(diag)) {
+            Logger::print(diag, log_fn);
+            writes.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (stopping.load(std::memory_order_acquire)) {
+            // Pushes racing with the stop are still let through
+            if (tail.load(std::memory_order_relaxed) == head.load(std::memory_order_acquire)) break;
+            continue;
+        }
+
+        // A push can land between the check and the wait without waking it up, so it doesn't
+        // sleep for long
+        std::unique_lock<std::mutex> lock(mutex);
+        sleeping.store(true, std::memory_order_release);
+        wake.wait_for(lock, std::chrono::milliseconds(10), [this]() {
+            return stopping.load() || slots[tail.load() & mask].seq.load() == tail.load() + 1;
+        });
+        sleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+/* -=- (S/g)etters -=- */
+size_t llama::LogSink::dropped() {
+    return drops.load(std::memory_order_relaxed);
+}
+
+size_t llama::LogSink::written() {
+    return writes.load(std::memory_order_relaxed);
+}
@@ -23,10 +23,16 @@ llama::Module::Module() {
     classes = new ClassPool();
     consts  = new ConstantPool();
     funcs   = new FunctionPool();
+    globals = new GlobalPool();
+    symbols = new SymbolPool();
 
     classes->mod = this;
     consts->mod  = this;
     funcs->mod   = this;
+    globals->mod = this;
+    symbols->mod = this;
+
+    folded = 0;
 }
 
 llama::Module::Module(const Module & mod) {
@@ -34,10 +40,16 @@ llama::Module::Module(const Module & mod) {
         classes = new ClassPool();
         consts  = new ConstantPool();
         funcs   = new FunctionPool();
+        globals = new GlobalPool();
+        symbols = new SymbolPool();
 
         classes->mod = mod.classes->mod;
         consts->mod  = mod.consts->mod;
         funcs->mod   = mod.funcs->mod;
+        globals->mod = mod.globals->mod;
+        symbols->mod = mod.symbols->mod;
+
+        folded = 0;
     }
 }
 
@@ -45,6 +57,8 @@ llama::Module::~Module() {
     delete classes;
     delete consts;
     delete funcs;
+    delete globals;
+    delete symbols;
 }
 
 /* -=- (S/g)etters -=- */
@@ -60,11 +74,30 @@ llama::FunctionPool * llama::Module::get_functions() {
     return funcs;
 }
 
+llama::GlobalPool * llama::Module::get_globals() {
+    return globals;
+}
+
+llama::SymbolPool * llama::Module::get_symbols() {
+    return symbols;
+}
+
+void llama::Module::add_folded(size_t count) {
+    folded += count;
+}
+
+size_t llama::Module::get_folded() {
+    return folded;
+}
+
 /* -=- Base functions -=- */
 void llama::Module::dump() {
     printf("-- CPOOL DUMP (%zu entries) --\n%s\n", consts->size(), consts->dump().c_str());
+    printf("-- SYMBOLS DUMP (%zu entries) --\n%s\n", symbols->size(), symbols->dump().c_str());
+    printf("-- GPOOL DUMP (%zu entries) --\n%s\n", globals->size(), globals->dump().c_str());
     printf("-- FUNCTIONS DUMP (%zu entries) --\n", funcs->size());
     for (size_t i = 0; i < funcs->size(); ++i) {
         printf("function %zu = %s\n", i, funcs->dump(i, true).c_str());
     }
+    printf("-- FOLDING: %zu instructions removed --\n\n", folded);
 }
\ No newline at end of file
@@ -124,14 +124,33 @@ size_t llama::ConstantPool::get(ConstantEntry entry) {
     if (it != entries.end()) return std::distance(entries.begin(), it);
 
     entries.push_back(entry);
+    symbols.push_back(ERROR_IDX_BIN);
     return entries.size() - 1;
 }
 
+size_t llama::ConstantPool::get_symbol(Symbol symbol) {
+    // Names are looked up by their symbol, so only the first use of each one goes through get()
+    if (symbol >= names.size()) names.resize(symbol + 1, ERROR_IDX_BIN);
+    if (names[symbol] != ERROR_IDX_BIN) return names[symbol];
+
+    size_t idx = get(ConstantEntry(mod->get_symbols()->name(symbol)));
+    names[symbol] = idx;
+    symbols[idx]  = symbol;
+    return idx;
+}
+
 llama::ConstantEntry * llama::ConstantPool::at(size_t idx) {
     if (idx >= entries.size()) return nullptr;
     return &entries[idx];
 }
 
+llama::Symbol llama::ConstantPool::symbol(size_t idx) {
+    // Strings that didn't come in as a name get their symbol the first time they're used as one
+    if (idx >= entries.size()) return ERROR_IDX_BIN;
+    if (symbols[idx] == ERROR_IDX_BIN) symbols[idx] = mod->get_symbols()->get(entries[idx].as_string());
+    return symbols[idx];
+}
+
 size_t llama::ConstantPool::size() {
     return entries.size();
 }
@@ -20,32 +20,68 @@
 
 /* -=- (Con/des)tructors -=- */
 llama::FunctionEntry::FunctionEntry() {
-    ext = nullptr;
+    symbol = ERROR_IDX_BIN;
+    ext    = nullptr;
+    line   = 0;
+    locals = 0;
 }
 
 llama::FunctionEntry::FunctionEntry(const FunctionEntry & entry) {
     name = entry.name;
     args = entry.args;
     data = entry.data;
-    ext  = entry.ext;
-    line = entry.line;
+    code = entry.code;
+    symbol = entry.symbol;
+    ext    = entry.ext;
+    line   = entry.line;
+    locals = entry.locals;
 }
 
 llama::FunctionEntry::~FunctionEntry() {}
 
 /* -=- Base functions -=- */
-void llama::FunctionEntry::set_name(std::string m_name) {
-    name = m_name;
+void llama::FunctionEntry::set_name(std::string m_name, Symbol m_symbol) {
+    name   = m_name;
+    symbol = m_symbol;
 }
 
 std::string llama::FunctionEntry::get_name() {
     return name;
 }
 
+llama::Symbol llama::FunctionEntry::get_symbol() {
+    return symbol;
+}
+
 std::vector<unsigned char> & llama::FunctionEntry::get_data() {
     return data;
 }
 
+std::vector<llama::DecodedInst> & llama::FunctionEntry::get_code() {
+    return code;
+}
+
+bool llama::FunctionEntry::decode(Module * mod) {
+    IRBuilder ir = IRBuilder();
+    ir.set_module(mod);
+    ir.read(data);
+    if (!ir.decode(code)) return false;
+
+    // Local slots must fit in the frame
+    for (auto & inst : code) {
+        bool is_local = inst.opcode == LLAMA_OP_NEWLOCAL || inst.opcode == LLAMA_OP_GETLOCAL || 
+                        inst.opcode == LLAMA_OP_SETLOCAL;
+        if (!is_local) continue;
+
+        if (inst.args[0] < 0 || (size_t)(inst.args[0]) >= std::max(locals, args.size())) {
+            code.clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
 int llama::FunctionEntry::get_line() {
     return line;
 }
@@ -54,6 +90,14 @@ void llama::FunctionEntry::set_line(int m_line) {
     line = m_line;
 }
 
+size_t llama::FunctionEntry::get_locals() {
+    return locals;
+}
+
+void llama::FunctionEntry::set_locals(size_t m_locals) {
+    locals = m_locals;
+}
+
 void llama::FunctionEntry::push_arg(Argument arg) {
     args.push_back(arg);
 }
@@ -74,6 +118,13 @@ size_t llama::FunctionEntry::get_argc() {
 /* -=- Base functions -=- */
 size_t llama::FunctionPool::add(FunctionEntry & entry) {
     entries.push_back(entry);
+
+    Symbol symbol = entry.get_symbol();
+    if (symbol != ERROR_IDX_BIN) {
+        if (symbol >= names.size()) names.resize(symbol + 1, ERROR_IDX_BIN);
+        names[symbol] = entries.size() - 1;
+    }
+
     return entries.size() - 1;
 }
 
@@ -94,6 +145,10 @@ bool llama::FunctionPool::has(std::string name) {
     return it != entries.end();
 }
 
+bool llama::FunctionPool::has(Symbol symbol) {
+    return symbol < names.size() && names[symbol] != ERROR_IDX_BIN;
+}
+
 size_t llama::FunctionPool::size() {
     return entries.size();
 }
@@ -0,0 +1,60 @@
+/* -=============
+     Includes
+   =============- */
+
+#include <error.h>
+#include <module.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/* -=====================
+     GlobalPool class
+   =====================- */
+
+/* -=- Base functions -=- */
+size_t llama::GlobalPool::get(Symbol symbol) {
+    if (symbol >= slots.size()) slots.resize(symbol + 1, ERROR_IDX_BIN);
+    if (slots[symbol] != ERROR_IDX_BIN) return slots[symbol];
+
+    symbols.push_back(symbol);
+    slots[symbol] = symbols.size() - 1;
+    return symbols.size() - 1;
+}
+
+size_t llama::GlobalPool::get(std::string name) {
+    return get(mod->get_symbols()->get(name));
+}
+
+size_t llama::GlobalPool::find(Symbol symbol) {
+    if (symbol >= slots.size()) return ERROR_IDX_BIN;
+    return slots[symbol];
+}
+
+size_t llama::GlobalPool::find(std::string name) {
+    // Names that were never interned can't have a slot either
+    return find(mod->get_symbols()->find(name));
+}
+
+std::string llama::GlobalPool::name(size_t idx) {
+    if (idx >= symbols.size()) return std::string();
+    return mod->get_symbols()->name(symbols[idx]);
+}
+
+size_t llama::GlobalPool::size() {
+    return symbols.size();
+}
+
+/* -=- Formatters -=- */
+std::string llama::GlobalPool::dump() {
+    std::string str;
+    for (size_t i = 0; i < symbols.size(); ++i) {
+        str += std::to_string(i);
+        str += ": ";
+        str += name(i);
+        str += "\n";
+    }
+    return str;
+}
@@ -0,0 +1,111 @@
+/* -=============
+     Includes
+   =============- */
+
+#include <error.h>
+#include <module.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/* -==============
+     Internals
+   ==============- */
+
+namespace llama {
+    static uint32_t hash_name(const char * str, size_t length) {
+        // FNV-1a, identifiers are short enough for it to be about free
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < length; ++i) {
+            hash ^= (unsigned char)(str[i]);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+}
+
+/* -=====================
+     SymbolPool class
+   =====================- */
+
+/* -=- (Con/des)tructors -=- */
+llama::SymbolPool::SymbolPool() {
+    slots.assign(64, ERROR_IDX_BIN);
+    mod = nullptr;
+}
+
+/* -=- Base functions -=- */
+llama::Symbol llama::SymbolPool::get(const char * str, size_t length) {
+    uint32_t hash = hash_name(str, length);
+    size_t   slot = probe(str, length, hash);
+    if (slots[slot] != ERROR_IDX_BIN) return slots[slot];
+
+    Symbol symbol = names.size();
+    names.push_back(std::string(str, length));
+    hashes.push_back(hash);
+    slots[slot] = symbol;
+
+    // Kept at most half full, so probes stay short
+    if (names.size() * 2 > slots.size()) grow();
+    return symbol;
+}
+
+llama::Symbol llama::SymbolPool::get(std::string str) {
+    return get(str.data(), str.length());
+}
+
+llama::Symbol llama::SymbolPool::find(const char * str, size_t length) {
+    return slots[probe(str, length, hash_name(str, length))];
+}
+
+llama::Symbol llama::SymbolPool::find(std::string str) {
+    return find(str.data(), str.length());
+}
+
+std::string llama::SymbolPool::name(Symbol symbol) {
+    if (symbol >= names.size()) return std::string();
+    return names[symbol];
+}
+
+size_t llama::SymbolPool::size() {
+    return names.size();
+}
+
+/* -=- Table management -=- */
+size_t llama::SymbolPool::probe(const char * str, size_t length, uint32_t hash) {
+    // Slot of the symbol, or the empty one it would go in. The text is only compared when the
+    // whole hash matches
+    size_t mask = slots.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        Symbol symbol = slots[i];
+        if (symbol == ERROR_IDX_BIN) return i;
+        if (hashes[symbol] == hash && names[symbol].length() == length && 
+            memcmp(names[symbol].data(), str, length) == 0) return i;
+    }
+}
+
+void llama::SymbolPool::grow() {
+    slots.assign(slots.size() * 2, ERROR_IDX_BIN);
+
+    size_t mask = slots.size() - 1;
+    for (Symbol symbol = 0; symbol < names.size(); ++symbol) {
+        size_t i = hashes[symbol] & mask;
+        while (slots[i] != ERROR_IDX_BIN) i = (i + 1) & mask;
+        slots[i] = symbol;
+    }
+}
+
+/* -=- Formatters -=- */
+std::string llama::SymbolPool::dump() {
+    std::string str;
+    for (size_t i = 0; i < names.size(); ++i) {
+        str += std::to_string(i);
+        str += ": ";
+        str += names[i];
+        str += "\n";
+    }
+    return str;
+}
@@ -0,0 +1,178 @@
+/* -=============
+     Includes
+   =============- */
+
+#include <resolver.h>
+#include <ast.h>
+#include <module.h>
+#include <error.h>
+
+#include <cstddef>
+#include <vector>
+
+/* -===================
+     Resolver class
+   ===================- */
+
+/* -=- (Con/des)tructors -=- */
+llama::Resolver::Resolver() {
+    depth      = 0;
+    max_locals = 0;
+    mod        = nullptr;
+    log        = nullptr;
+}
+
+/* -=- Base functions -=- */
+void llama::Resolver::setup(Module * m_mod, Logger * m_log) {
+    mod = m_mod;
+    log = m_log;
+
+    locals.clear();
+    depth      = 0;
+    max_locals = 0;
+}
+
+llama::Status llama::Resolver::resolve(Node * node) {
+    switch (node->kind) {
+        case Node::Kind::Null:
+        case Node::Kind::True:
+        case Node::Kind::False:
+        case Node::Kind::Integer:
+        case Node::Kind::Decimal:
+        case Node::Kind::String:
+        case Node::Kind::Repeat:
+        case Node::Kind::Break: return Ok;
+
+        case Node::Kind::Name: {
+            NameNode * name = node->as<NameNode>();
+            name->slot = find_local(name->name);
+            return Ok;
+        }
+        case Node::Kind::Property: return resolve(node->as<PropertyNode>()->object);
+        case Node::Kind::Unary:    return resolve(node->as<UnaryNode>()->operand);
+        case Node::Kind::Binary: {
+            BinaryNode * binary = node->as<BinaryNode>();
+            if (resolve(binary->lhs) != Ok) return Failure;
+            return resolve(binary->rhs);
+        }
+        case Node::Kind::Call: {
+            CallNode * call = node->as<CallNode>();
+            if (resolve(call->callee) != Ok) return Failure;
+            for (size_t i = 0; i < call->args.size; ++i) {
+                if (resolve(call->args.items[i]) != Ok) return Failure;
+            }
+            return Ok;
+        }
+        case Node::Kind::Assign: {
+            AssignNode * assign = node->as<AssignNode>();
+            if (resolve(assign->value) != Ok) return Failure;
+            assign->slot = find_local(assign->name);
+            return Ok;
+        }
+        case Node::Kind::SetProperty: return resolve(node->as<SetPropertyNode>()->value);
+
+        case Node::Kind::ExprStmt: return resolve(node->as<ExprStmtNode>()->expr);
+        case Node::Kind::Decl: {
+            DeclNode * decl = node->as<DeclNode>();
+
+            // Locals are declared before their value, which already sees them
+            if (decl->local && declare_local(decl->name) == ERROR_IDX) {
+                log->set_snippet(decl->snippet());
+                SYNTAXERROR(AlreadyDeclared, "the local %s was already declared in this scope", mod->get_symbols()->name(decl->name).c_str());
+                return Failure;
+            }
+
+            if (decl->value != nullptr && resolve(decl->value) != Ok) return Failure;
+            decl->slot = find_local(decl->name);
+            return Ok;
+        }
+        case Node::Kind::Block: return resolve_block(node->as<BlockNode>());
+        case Node::Kind::If: {
+            IfNode * stmt = node->as<IfNode>();
+            if (resolve(stmt->cond) != Ok || resolve_block(stmt->then) != Ok) return Failure;
+            if (stmt->otherwise != nullptr) return resolve_block(stmt->otherwise);
+            return Ok;
+        }
+        case Node::Kind::While: {
+            WhileNode * stmt = node->as<WhileNode>();
+            if (resolve(stmt->cond) != Ok) return Failure;
+            return resolve_block(stmt->body);
+        }
+        case Node::Kind::Loop:   return resolve_block(node->as<LoopNode>()->body);
+        case Node::Kind::Fn:     return resolve_fn(node->as<FnNode>());
+        case Node::Kind::Return: {
+            ReturnNode * stmt = node->as<ReturnNode>();
+            if (stmt->value != nullptr) return resolve(stmt->value);
+            return Ok;
+        }
+    }
+
+    return Ok;
+}
+
+llama::Status llama::Resolver::resolve_block(BlockNode * node) {
+    begin_scope();
+    for (size_t i = 0; i < node->body.size; ++i) {
+        if (resolve(node->body.items[i]) != Ok) return Failure;
+    }
+    end_scope();
+
+    return Ok;
+}
+
+llama::Status llama::Resolver::resolve_fn(FnNode * node) {
+    // Functions get a frame of their own, whose first locals are the arguments
+    std::vector<Local> prev_locals     = locals;
+    size_t             prev_depth      = depth;
+    size_t             prev_max_locals = max_locals;
+
+    locals.clear();
+    depth      = 1;
+    max_locals = 0;
+
+    for (size_t i = 0; i < node->argc; ++i) declare_local(node->args[i].symbol);
+
+    Status status = resolve_block(node->body);
+    node->locals  = max_locals;
+
+    locals     = prev_locals;
+    depth      = prev_depth;
+    max_locals = prev_max_locals;
+
+    return status;
+}
+
+/* -=- Scopes -=- */
+void llama::Resolver::begin_scope() {
+    ++depth;
+}
+
+void llama::Resolver::end_scope() {
+    while (!locals.empty() && locals.back().depth >= depth) locals.pop_back();
+    --depth;
+}
+
+size_t llama::Resolver::declare_local(Symbol name) {
+    for (size_t i = locals.size(); i-- > 0;) {
+        if (locals[i].depth < depth) break;
+        if (locals[i].name == name) return ERROR_IDX;
+    }
+
+    locals.push_back({ name, depth });
+    if (locals.size() > max_locals) max_locals = locals.size();
+
+    return locals.size() - 1;
+}
+
+size_t llama::Resolver::find_local(Symbol name) {
+    // Searches backwards so inner scopes shadow the outer ones
+    for (size_t i = locals.size(); i-- > 0;) {
+        if (locals[i].name == name) return i;
+    }
+    return ERROR_IDX;
+}
+
+/* -=- (S/g)etters -=- */
+size_t llama::Resolver::get_max_locals() {
+    return max_locals;
+}
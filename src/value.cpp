@@ -5,6 +5,7 @@
 #include <error.h>
 #include <value.h>
 
+#include <cstdint>
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
@@ -24,236 +25,168 @@ namespace llama {
      Value class
    ================- */
 
-/* -=- (Con/des)tructors -=- */
-llama::Value::Value() {
-    type = Type::Null;
-    data = { 0 };
-}
-
-llama::Value::Value(const Value & value) {
-    if (this != &value) {
-        type = value.type;
-        data = value.data;
-        if (IS_REFTYPE(type)) {
-            auto & tdata = data.__udata;
-            auto & vdata = value.data.__udata;
-
-            tdata.__size = vdata.__size;
-            tdata.__ptr  = malloc(vdata.__size);
-            memcpy(tdata.__ptr, vdata.__ptr, vdata.__size);
-        }
-    }
-}
-
-llama::Value::~Value() {
-    if (IS_REFTYPE(type)) {
-        free(data.__udata.__ptr);
-        data.__udata.__ptr = nullptr;
-    }
-    type = Type::Null;
-}
-
-llama::Value::Value(bool v) {
-    type        = Type::Bool;
-    data.__bool = v;
-}
-
-llama::Value::Value(int v) {
-    type       = Type::Int;
-    data.__int = v;
-}
-
-llama::Value::Value(double v) {
-    type         = Type::Float;
-    data.__float = v;
-}
-
-llama::Value::Value(size_t idx, Type m_type) {
-    type       = m_type;
-    data.__idx = idx;
-}
-
 /* -=- Metafunctions -=- */
-llama::Value llama::Value::_add(Value other) {
-    Value val = * this;
-    if (val.type != other.type) return Value();
-
-    if (val.type == Type::Int) {
-        val.data.__int += other.data.__int;
-    } else if (val.type == Type::Float) {
-        val.data.__float += other.data.__float;
+llama::Value llama::Value::_add(const Value & other) const {
+    Type type = get_type();
+    if (type != other.get_type()) return Value();
+
+    if (type == Type::Int) {
+        return Value((int)((uint32_t)(get_int()) + (uint32_t)(other.get_int())));
+    } else if (type == Type::Float) {
+        return Value(get_float() + other.get_float());
     }
 
-    return val;
+    return * this;
 }
 
-llama::Value llama::Value::_sub(Value other) {
-    Value val = * this;
-    if (val.type != other.type) return Value();
+llama::Value llama::Value::_sub(const Value & other) const {
+    Type type = get_type();
+    if (type != other.get_type()) return Value();
 
-    if (val.type == Type::Int) {
-        val.data.__int -= other.data.__int;
-    } else if (val.type == Type::Float) {
-        val.data.__float -= other.data.__float;
+    if (type == Type::Int) {
+        return Value((int)((uint32_t)(get_int()) - (uint32_t)(other.get_int())));
+    } else if (type == Type::Float) {
+        return Value(get_float() - other.get_float());
     }
     
-    return val;
+    return * this;
 }
 
-llama::Value llama::Value::_mul(Value other) {
-    Value val = * this;
-    if (val.type != other.type) return Value();
+llama::Value llama::Value::_mul(const Value & other) const {
+    Type type = get_type();
+    if (type != other.get_type()) return Value();
 
-    if (val.type == Type::Int) {
-        val.data.__int *= other.data.__int;
-    } else if (val.type == Type::Float) {
-        val.data.__float *= other.data.__float;
+    if (type == Type::Int) {
+        return Value((int)((uint32_t)(get_int()) * (uint32_t)(other.get_int())));
+    } else if (type == Type::Float) {
+        return Value(get_float() * other.get_float());
     }
     
-    return val;
+    return * this;
 }
 
-llama::Value llama::Value::_div(Value other) {
-    Value val = * this;
-    if (val.type != other.type) return Value();
+llama::Value llama::Value::_div(const Value & other) const {
+    Type type = get_type();
+    if (type != other.get_type()) return Value();
 
-    if (val.type == Type::Int) {
-        val.data.__int /= other.data.__int;
-    } else if (val.type == Type::Float) {
-        val.data.__float /= other.data.__float;
+    if (type == Type::Int) {
+        return Value(get_int() / other.get_int());
+    } else if (type == Type::Float) {
+        return Value(get_float() / other.get_float());
     }
     
-    return val;
+    return * this;
 }
 
-llama::Value llama::Value::_mod(Value other) {
-    Value val = * this;
-    if (val.type != other.type) return Value();
+llama::Value llama::Value::_mod(const Value & other) const {
+    Type type = get_type();
+    if (type != other.get_type()) return Value();
 
-    if (val.type == Type::Int) {
-        val.data.__int %= other.data.__int;
-    } else if (val.type == Type::Float) {
-        val.data.__float = fmod(val.data.__float, other.data.__float);
+    if (type == Type::Int) {
+        return Value(get_int() % other.get_int());
+    } else if (type == Type::Float) {
+        return Value(fmod(get_float(), other.get_float()));
     }
     
-    return val;
+    return * this;
 }
 
-llama::Value llama::Value::_pow(Value other) {
-    Value val = * this;
-    if (val.type == Type::Int && other.type == Type::Int) {
-        val.data.__int = pow(val.data.__int, other.data.__int);
-    } else if (val.type == Type::Float && other.type == Type::Float) {
-        val.data.__float = powf(val.data.__float, other.data.__float);
-    } else val.type = Type::Null;
-    return val;
+llama::Value llama::Value::_pow(const Value & other) const {
+    Type type = get_type();
+    if (type == Type::Int && other.get_type() == Type::Int) {
+        return Value((int)(pow(get_int(), other.get_int())));
+    } else if (type == Type::Float && other.get_type() == Type::Float) {
+        return Value((double)(powf(get_float(), other.get_float())));
+    }
+    return Value();
 }
 
-llama::Value llama::Value::_eq(Value other) {
-    Value val = Value(false);
-    if (val.type != other.type) return val;
+llama::Value llama::Value::_eq(const Value & other) const {
+    Type type = get_type();
+    if (type != other.get_type()) return Value(false);
 
-    if (val.type == Type::Bool) {
-        val.data.__bool = data.__bool == other.data.__bool;
-    } else if (val.type == Type::Int) {
-        val.data.__bool = data.__int == other.data.__int;
-    } else if (val.type == Type::Float) {
-        val.data.__bool = data.__float == other.data.__float;
+    switch (type) {
+        case Type::Null:   return Value(true);
+        case Type::Bool:   return Value(get_bool() == other.get_bool());
+        case Type::Int:    return Value(get_int() == other.get_int());
+        case Type::Float:  return Value(get_float() == other.get_float());
+        case Type::String: {
+            return Value(get_object() == other.get_object() || 
+                         strcmp((const char *)(payload()), (const char *)(other.payload())) == 0);
+        }
+        default: {
+            if (IS_REFTYPE(type)) return Value(get_object() == other.get_object());
+            return Value(get_idx() == other.get_idx());
+        }
     }
-
-    return val;
 }
 
-llama::Value llama::Value::_lt(Value other) {
-    Value val = Value(false);
-    if (val.type == Type::Bool && other.type == Type::Bool) {
-        val.data.__bool = data.__bool < other.data.__bool;
-    } else if (val.type == Type::Int && other.type == Type::Int) {
-        val.data.__bool = data.__int < other.data.__int;
-    } else if (val.type == Type::Float && other.type == Type::Float) {
-        val.data.__bool = data.__float < other.data.__float;
+llama::Value llama::Value::_lt(const Value & other) const {
+    Type type = get_type();
+    if (type == Type::Bool && other.get_type() == Type::Bool) {
+        return Value(get_bool() < other.get_bool());
+    } else if (type == Type::Int && other.get_type() == Type::Int) {
+        return Value(get_int() < other.get_int());
+    } else if (type == Type::Float && other.get_type() == Type::Float) {
+        return Value(get_float() < other.get_float());
     }
-    return val;
+    return Value(false);
 }
 
-llama::Value llama::Value::_le(Value other) {
-    Value val = Value(false);
-    if (val.type == Type::Bool && other.type == Type::Bool) {
-        val.data.__bool = data.__bool <= other.data.__bool;
-    } else if (val.type == Type::Int && other.type == Type::Int) {
-        val.data.__bool = data.__int <= other.data.__int;
-    } else if (val.type == Type::Float && other.type == Type::Float) {
-        val.data.__bool = data.__float <= other.data.__float;
+llama::Value llama::Value::_le(const Value & other) const {
+    Type type = get_type();
+    if (type == Type::Bool && other.get_type() == Type::Bool) {
+        return Value(get_bool() <= other.get_bool());
+    } else if (type == Type::Int && other.get_type() == Type::Int) {
+        return Value(get_int() <= other.get_int());
+    } else if (type == Type::Float && other.get_type() == Type::Float) {
+        return Value(get_float() <= other.get_float());
     }
-    return val;
+    return Value(false);
 }
 
-llama::Value llama::Value::_gt(Value other) {
-    Value val = Value(false);
-    if (val.type == Type::Bool && other.type == Type::Bool) {
-        val.data.__bool = data.__bool > other.data.__bool;
-    } else if (val.type == Type::Int && other.type == Type::Int) {
-        val.data.__bool = data.__int > other.data.__int;
-    } else if (val.type == Type::Float && other.type == Type::Float) {
-        val.data.__bool = data.__float > other.data.__float;
+llama::Value llama::Value::_gt(const Value & other) const {
+    Type type = get_type();
+    if (type == Type::Bool && other.get_type() == Type::Bool) {
+        return Value(get_bool() > other.get_bool());
+    } else if (type == Type::Int && other.get_type() == Type::Int) {
+        return Value(get_int() > other.get_int());
+    } else if (type == Type::Float && other.get_type() == Type::Float) {
+        return Value(get_float() > other.get_float());
     }
-    return val;
+    return Value(false);
 }
 
-llama::Value llama::Value::_ge(Value other) {
-    Value val = Value(false);
-    if (val.type == Type::Bool && other.type == Type::Bool) {
-        val.data.__bool = data.__bool >= other.data.__bool;
-    } else if (val.type == Type::Int && other.type == Type::Int) {
-        val.data.__bool = data.__int >= other.data.__int;
-    } else if (val.type == Type::Float && other.type == Type::Float) {
-        val.data.__bool = data.__float >= other.data.__float;
+llama::Value llama::Value::_ge(const Value & other) const {
+    Type type = get_type();
+    if (type == Type::Bool && other.get_type() == Type::Bool) {
+        return Value(get_bool() >= other.get_bool());
+    } else if (type == Type::Int && other.get_type() == Type::Int) {
+        return Value(get_int() >= other.get_int());
+    } else if (type == Type::Float && other.get_type() == Type::Float) {
+        return Value(get_float() >= other.get_float());
     }
-    return val;
+    return Value(false);
 }
 
-llama::Value llama::Value::_ne(Value other) {
-    Value val = Value(false);
-    if (val.type == Type::Bool && other.type == Type::Bool) {
-        val.data.__bool = data.__bool != other.data.__bool;
-    } else if (val.type == Type::Int && other.type == Type::Int) {
-        val.data.__bool = data.__int != other.data.__int;
-    } else if (val.type == Type::Float && other.type == Type::Float) {
-        val.data.__bool = data.__float != other.data.__float;
-    }
-    return val;
+llama::Value llama::Value::_ne(const Value & other) const {
+    return Value(!_eq(other).get_bool());
 }
 
-llama::Value llama::Value::_negate() {
-    Value val = * this;
-    switch (val.type) {
-        case Type::Int: {
-            val.data.__int = -val.data.__int;
-            break;
-        }
-        case Type::Float: {
-            val.data.__float = -val.data.__float;
-            break;
-        }
-        default: val.type = Type::Null;
+llama::Value llama::Value::_negate() const {
+    switch (get_type()) {
+        case Type::Int:   return Value((int)(0u - (uint32_t)(get_int())));
+        case Type::Float: return Value(-get_float());
+        default:          return Value();
     }
-    return val;
 }
 
-llama::Value llama::Value::_promote() {
-    Value val = * this;
-    switch (val.type) {
-        case Type::Int: {
-            val.data.__int = +val.data.__int;
-            break;
-        }
-        case Type::Float: {
-            val.data.__float = +val.data.__float;
-            break;
-        }
-        default: val.type = Type::Null;
+llama::Value llama::Value::_promote() const {
+    switch (get_type()) {
+        case Type::Int:   return Value(+get_int());
+        case Type::Float: return Value(+get_float());
+        default:          return Value();
     }
-    return val;
 }
 
 llama::Value llama::Value::_sizeof() {
@@ -261,61 +194,54 @@ llama::Value llama::Value::_sizeof() {
 }
 
 /* -=- Data management -=- */
+void * llama::Value::payload() const {
+    if (!IS_REFTYPE(get_type())) return nullptr;
+    return get_object() + 1;
+}
+
 size_t llama::Value::size() {
-    switch (type) {
+    switch (get_type()) {
         case Type::Null:     return 0;
         case Type::Bool:     return sizeof(bool);
         case Type::Int:      return sizeof(int);
         case Type::Float:    return sizeof(double);
-        case Type::String:   return 0;
-        case Type::List:     return 0;
-        case Type::Object:   return 0;
-        case Type::Userdata: return 0;
+        case Type::String:   return get_object()->size;
+        case Type::List:     return get_object()->size;
+        case Type::Object:   return get_object()->size;
+        case Type::Userdata: return get_object()->size;
         case Type::Dynamic:  return 0;
         default:             return 0;
     }
 }
 
 /* -=- Converters -=- */
-llama::Value llama::Value::convert(std::string conv_type) {
-    Value v = Value();
-    switch (type) {
+llama::Value llama::Value::convert(const char * conv_type) {
+    switch (get_type()) {
         case Type::Bool: {
-            if (conv_type == "int") {
-                v.type         = Type::Float;
-                v.data.__float = (int)data.__bool;
-            } else if (conv_type == "float") {
-                v.type         = Type::Float;
-                v.data.__float = (double)data.__bool;
-            }
+            if (strcmp(conv_type, "int") == 0)   return Value((int)(get_bool()));
+            if (strcmp(conv_type, "float") == 0) return Value((double)(get_bool()));
             break;
         }
         case Type::Int: {
-            if (conv_type == "float") {
-                v.type         = Type::Float;
-                v.data.__float = (double)data.__int;
-            }
+            if (strcmp(conv_type, "float") == 0) return Value((double)(get_int()));
             break;
         }
         case Type::Float: {
-            if (conv_type == "int") {
-                v.type       = Type::Int;
-                v.data.__int = (int)data.__float;
-            }
+            if (strcmp(conv_type, "int") == 0) return Value((int)(get_float()));
             break;
         }
         default: break;
     }
-    return v;
+    return Value();
 }
 
 std::string llama::Value::as_string() {
-    if (type == Type::Null) return "null";
-
-    switch (type) {
-        case Type::Bool:   return std::string(data.__bool ? "true" : "false");
-        case Type::Int:    return std::to_string(data.__int);
-        case Type::Float:  return std::to_string(data.__float);
+    switch (get_type()) {
+        case Type::Null:   return "null";
+        case Type::Bool:   return std::string(get_bool() ? "true" : "false");
+        case Type::Int:    return std::to_string(get_int());
+        case Type::Float:  return std::to_string(get_float());
+        case Type::String: return std::string((const char *)(payload()));
         case Type::List: {
             // std::string str = "[";
             // for (size_t i = 0; i < data.__list->__size; ++i) {
@@ -329,8 +255,8 @@ std::string llama::Value::as_string() {
 }
 
 /* -=- Utils -=- */
-const char * llama::Value::type_str() {
-    switch (type) {
+const char * llama::Value::type_str() const {
+    switch (get_type()) {
         case Type::Null:     return "null";
         case Type::Bool:     return "bool";
         case Type::Int:      return "int";
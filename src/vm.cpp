@@ -15,46 +15,161 @@
 #include <cerrno>
 #include <ctime>
 #include <string>
+#include <new>
+#include <utility>
+
+/* -==============
+     Internals
+   ==============- */
+
+#define VM_ALIGN(__n) (((__n) + 15) & ~(uintptr_t)(15)) // Carved parts of a memory block stay 16 bytes aligned
 
 /* -=============
      VM class
    =============- */
 
 /* -=- (Con/des)tructors -=- */
-llama::VM::VM() {
+llama::VM::VM(VMConfig m_config) {
+    config = m_config;
     log    = new Logger();
     module = new Module();
+    log->set_level(config.log_level);
+    log->set_handlers(config.exit, config.panic, config.log);
+    if (config.flags & LLAMA_CFG_QUIET) log->set_quiet();
+    setup_sink();
+    setup_memory();
 }
 
 llama::VM::VM(const VM & vm) {
-    log    = new Logger();
-    module = new Module(* vm.module);
+    // A memory block can't be shared, so copies always live on the system heap
+    config             = vm.config;
+    config.memory      = nullptr;
+    config.memory_size = 0;
+    log                = new Logger();
+    module             = new Module(* vm.module);
+    log->set_level(config.log_level);
+    log->set_handlers(config.exit, config.panic, config.log);
+    if (config.flags & LLAMA_CFG_QUIET) log->set_quiet();
+    setup_sink();
+    setup_memory();
 }
 
 llama::VM::~VM() {
+    // Whatever is still queued is written before the logger goes away
+    delete sink;
     delete log;
     delete module;
+    delete heap;
+
+    if (config.memory == nullptr) {
+        delete[] stack;
+        delete[] frames;
+        delete[] globals;
+    }
+}
+
+void llama::VM::setup_sink() {
+    sink = nullptr;
+    if (!(config.flags & LLAMA_CFG_ASYNCLOG)) return;
+
+    sink = new LogSink(config.log_queue, config.log);
+    log->set_sink(sink);
+}
+
+void llama::VM::setup_memory() {
+    size_t limit = config.memory_limit * 1024;
+
+    global_count = 0;
+
+    if (config.memory == nullptr) {
+        heap       = new Heap(this, new Allocator(config.alloc, config.free, config.alloc_data), limit, 
+                              config.flags & LLAMA_CFG_INCGC, config.gc_budget);
+        stack      = new Value[config.stack_size];
+        frames     = new CallFrame[config.call_depth];
+        globals    = nullptr;
+        global_cap = 0;
+    } else {
+        // Carves the fixed-size parts first, whatever is left becomes the object heap
+        char * cur = (char *)(config.memory);
+        char * end = cur + config.memory_size;
+
+        size_t stack_bytes   = VM_ALIGN(config.stack_size * sizeof(Value));
+        size_t frames_bytes  = VM_ALIGN(config.call_depth * sizeof(CallFrame));
+        size_t globals_bytes = VM_ALIGN(config.global_count * sizeof(Value));
+
+        // Too small a block leaves the VM without memory, loads then fail instead of running
+        cur = (char *)(VM_ALIGN((uintptr_t)(cur)));
+        if (cur > end || (size_t)(end - cur) < stack_bytes + frames_bytes + globals_bytes) {
+            heap       = nullptr;
+            stack      = nullptr;
+            frames     = nullptr;
+            globals    = nullptr;
+            global_cap = 0;
+            sp         = nullptr;
+            fp         = nullptr;
+            return;
+        }
+
+        stack   = (Value *)(cur);     cur += stack_bytes;
+        frames  = (CallFrame *)(cur); cur += frames_bytes;
+        globals = (Value *)(cur);     cur += globals_bytes;
+
+        for (size_t i = 0; i < config.stack_size; ++i) new (&stack[i]) Value();
+
+        size_t heap_size = cur < end ? end - cur : 0;
+        if (limit == 0 || limit > heap_size) limit = heap_size;
+
+        heap       = new Heap(this, new Allocator(cur, heap_size), limit, config.flags & LLAMA_CFG_INCGC, 
+                              config.gc_budget);
+        heap->fix_gray(config.stack_size + config.global_count);
+        global_cap = config.global_count;
+    }
+
+    sp = stack;
+    fp = frames;
 }
 
 /* -=- Stack management -=- */
 void llama::VM::push() {
-    stack.push_back(Value());
+    push(Value());
 }
 
 void llama::VM::push(Value & v) {
-    stack.push_back(v);
+    if (sp >= stack + config.stack_size) {
+        RUNTIMEERROR(StackOverflow, "stack overflow (more than %zu values)", config.stack_size);
+        return;
+    }
+    * sp++ = v;
 }
 
 void llama::VM::push(Value && v) {
-    stack.push_back(v);
+    if (sp >= stack + config.stack_size) {
+        RUNTIMEERROR(StackOverflow, "stack overflow (more than %zu values)", config.stack_size);
+        return;
+    }
+    * sp++ = v;
 }
 
 void llama::VM::set_global(std::string name, int value) {
+    Value * val = get(value);
+    if (val == nullptr) {
+        RUNTIMEERROR(InvalidStack, "invalid stack index %d", value);
+        return;
+    }
 
+    size_t slot = module->get_globals()->get(name);
+    if (!reserve_globals(slot + 1)) return;
+    heap->barrier(* val);
+    globals[slot] = * val;
 }
 
 void llama::VM::get_global(std::string name) {
-
+    size_t slot = module->get_globals()->find(name);
+    if (slot == ERROR_IDX_BIN || slot >= global_count) {
+        push();
+        return;
+    }
+    push(globals[slot]);
 }
 
 void llama::VM::set_property(std::string name, int idx, int value) {
@@ -72,15 +187,15 @@ void llama::VM::set_index(int idx) {
     Value * val   = get(-1);
     
     if (list == nullptr || val == nullptr || index == nullptr) {
-        RUNTIMEERROR("attempted to index a null value");
+        RUNTIMEERROR(TypeMismatch, "attempted to index a null value");
         return;
     }
 
-    if (list->type != Type::List) {
-        RUNTIMEERROR("attempted to index a %s value", list->type_str());
+    if (list->get_type() != Type::List) {
+        RUNTIMEERROR(TypeMismatch, "attempted to index a %s value", list->type_str());
         return;
-    } else if (index->type != Type::Int) {
-        RUNTIMEERROR("index must be an integer, got %s instead", index->type_str());
+    } else if (index->get_type() != Type::Int) {
+        RUNTIMEERROR(TypeMismatch, "index must be an integer, got %s instead", index->type_str());
         return;
     }
 
@@ -94,11 +209,9 @@ void llama::VM::get_index(int idx) {
 }
 
 void llama::VM::new_global(std::string name) {
-    if (globals.find(name) != globals.end()) {
-        RUNTIMEERROR("the global %s was already declared in this scope", name.c_str());
-        return;
-    }
-    globals.insert({ name, Value() });
+    size_t slot = module->get_globals()->get(name);
+    if (!reserve_globals(slot + 1)) return;
+    globals[slot] = Value();
 }
 
 void llama::VM::new_local(std::string name) {
@@ -107,83 +220,173 @@ void llama::VM::new_local(std::string name) {
 }
 
 void llama::VM::pop() {
-    stack.pop_back();
+    * --sp = Value();
 }
 
 void llama::VM::popn(int n) {
-    if (n == 0) return;
-    stack.erase(stack.end() - n, stack.end());
+    while (n-- > 0) * --sp = Value();
 }
 
 /* -=- Function calls -=- */
 llama::Status llama::VM::call(size_t argc, bool pop) {
+    if (config.flags & LLAMA_CFG_RECOVER) log->set_recoverable();
+    if (!has_memory()) return Failure;
+
     VMRunner runner = VMRunner(this);
     return runner.exec(argc, pop);
 }
 
 llama::Status llama::VM::callv(size_t argc, bool pop) {
+    if (config.flags & LLAMA_CFG_RECOVER) log->set_recoverable();
+    if (!has_memory()) return Failure;
+
     VMRunner runner = VMRunner(this);
     return runner.exec(argc, pop);
 }
 
+/* -=- Globals -=- */
+bool llama::VM::reserve_globals(size_t count) {
+    if (count <= global_count) return true;
+
+    if (count > global_cap) {
+        // The table of a memory block is sized once and for all
+        if (config.memory != nullptr) {
+            RUNTIMEERROR(TooManyGlobals, "too many globals (more than %zu)", global_cap);
+            return false;
+        }
+
+        size_t cap = global_cap * 2 > count ? global_cap * 2 : count;
+
+        Value * table = new Value[cap];
+        for (size_t i = 0; i < global_count; ++i) table[i] = globals[i];
+        delete[] globals;
+
+        globals    = table;
+        global_cap = cap;
+    }
+
+    for (size_t i = global_count; i < count; ++i) globals[i] = Value();
+    global_count = count;
+
+    return true;
+}
+
 /* -=- Utilities -=- */
+bool llama::VM::has_memory() {
+    if (heap != nullptr) return true;
+
+    size_t needed = VM_ALIGN(config.stack_size * sizeof(Value)) + VM_ALIGN(config.call_depth * sizeof(CallFrame)) + 
+                    VM_ALIGN(config.global_count * sizeof(Value));
+    RUNTIMEERROR(OutOfMemory, "memory block too small (%zu bytes needed before the heap, got %zu)", needed, 
+                 config.memory_size);
+    return false;
+}
+
 llama::Value * llama::VM::get(int idx) {
     size_t i = REAL_IDX(idx);
-    if (i > stack.size()) return nullptr;
+    if (i >= (size_t)(sp - stack)) return nullptr;
     return &stack[i];
 }
 
+llama::Module * llama::VM::get_module() {
+    return module;
+}
+
+llama::Heap * llama::VM::get_heap() {
+    return heap;
+}
+
+llama::Logger * llama::VM::get_logger() {
+    return log;
+}
+
+llama::LogSink * llama::VM::get_sink() {
+    return sink;
+}
+
 void llama::VM::dump() {
     printf("-- STACK DUMP --\n");
-    for (size_t i = 0; i < stack.size(); ++i) {
+    for (size_t i = 0; i < (size_t)(sp - stack); ++i) {
         printf("%zu: %s (%s)\n", i, stack[i].as_string().c_str(), stack[i].type_str());
     }
 
     printf("-- GLOBALS DUMP --\n");
-    for (auto & i : globals) {
-        printf("%s: %s (%s)\n", i.first.c_str(), i.second.as_string().c_str(), i.second.type_str());
+    for (size_t i = 0; i < global_count; ++i) {
+        printf("%s: %s (%s)\n", module->get_globals()->name(i).c_str(), globals[i].as_string().c_str(), 
+               globals[i].type_str());
     }
 }
 
 /* -=- Code loading -=- */
 llama::Status llama::VM::load_string(const char * str) {
+    // Errors of earlier calls don't belong to this load
+    log->reset();
     log->set_source("string");
-    Status s = read(str);
+    if (config.flags & LLAMA_CFG_RECOVER) log->set_recoverable();
+
+    if (!has_memory()) {
+        log->reset();
+        return Failure;
+    }
+
+    Lexer lex;
+    lex.set_symbols(module->get_symbols());
+    lex.parse(log, std::string(str), config.lex_threads);
+
+    Status s = read(lex);
     log->reset();
     return s;
 }
 
 llama::Status llama::VM::load_file(const char * path) {
+    log->reset();
+    if (config.flags & LLAMA_CFG_RECOVER) log->set_recoverable();
+
+    if (!has_memory()) {
+        log->reset();
+        return Failure;
+    }
+
     FILE * f = fopen(path, "r");
     if (f == nullptr) {
-        RUNTIMEERROR(strerror(ferror(f)));
+        RUNTIMEERROR(FileError, "%s: %s", path, strerror(errno));
+        log->reset();
         return Failure;
     }
 
-    fseek(f, 0, SEEK_END);
-    size_t size = ftell(f);
-    fseek(f, 0, SEEK_SET);
+    log->set_source(path);
 
-    std::string str;
-    str.resize(size);
+    // The file is read in chunks while it's being compiled, unless it gets lexed by several threads
+    // (which needs all of it at once)
+    Lexer lex;
+    lex.set_symbols(module->get_symbols());
+    if (config.lex_threads > 1) {
+        fseek(f, 0, SEEK_END);
+        size_t size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+
+        std::string str;
+        str.resize(size);
+        str.resize(fread(&str[0], sizeof(char), size, f));
+
+        lex.parse(log, std::move(str), config.lex_threads);
+    } else {
+        lex.parse(log, f);
+    }
 
-    fread(&str[0], sizeof(char), size, f);
+    Status s = read(lex);
+    log->reset();
 
     fclose(f);
 
-    log->set_source(path);
-    Status s = read(str);
-    log->reset();
-
     return s;
 }
 
 llama::Status llama::VM::do_string(const char * str) {
     Status s = load_string(str);
     if (s != Failure) {
-        Value fn = Value(module->get_functions()->size() - 1, Type::Function);
-        stack.push_back(fn);
-        call(0, true);
+        push(Value(module->get_functions()->size() - 1, Type::Function));
+        s = call(0, true);
     }
     return s;
 }
@@ -191,31 +394,44 @@ llama::Status llama::VM::do_string(const char * str) {
 llama::Status llama::VM::do_file(const char * path) {
     Status s = load_file(path);
     if (s != Failure) {
-        Value fn = Value(module->get_functions()->size() - 1, Type::Function);
-        stack.push_back(fn);
-        call(0, true);
+        push(Value(module->get_functions()->size() - 1, Type::Function));
+        s = call(0, true);
     }
     return s;
 }
 
-llama::Status llama::VM::read(std::string str) {
+llama::Status llama::VM::read(Lexer & lex) {
     Status status = Ok;
 
-#ifdef LLAMA_DEBUG
+#if LLAMA_LOG_COMPILED(LLAMA_LOG_INFO)
     clock_t start = clock();
 #endif
 
-    Lexer lex;
-    lex.parse(log, str);
-    //lex.dump();
-
+    // Tokens are pulled out of the lexer as the analyser goes
     Analyser analysis;
     analysis.read(module, log, &lex);
     //analysis.dump();
 
-    module->dump();
+    // Only reached with errors when they are recoverable, and nothing half compiled may run
+    if (log->has_error()) return Failure;
+
+    // Decodes every new function once, so the runner only sees ready-to-dispatch code
+    auto * funcs = module->get_functions();
+    for (size_t i = 0; i < funcs->size(); ++i) {
+        auto * func = funcs->at(i);
+        if (!func->get_code().empty()) continue;
+        if (!func->decode(module)) {
+            RUNTIMEERROR(MalformedBytecode, "malformed bytecode in function %zu", i);
+            status = Failure;
+        }
+    }
+
+    if (!reserve_globals(module->get_globals()->size())) status = Failure;
+
+#if LLAMA_LOG_COMPILED(LLAMA_LOG_INFO)
+    // Disassembling the whole module is as much tracing as anything else
+    if (log->enabled(Logger::Info)) module->dump();
 
-#ifdef LLAMA_DEBUG
     double secs   = (double)(clock() - start) / CLOCKS_PER_SEC;
     double millis = secs * 1000;
     INFO("finished parsing in %fms (%fs)", millis, secs);
@@ -10,12 +10,76 @@
 #include <ir.h>
 #include <util.h>
 
+#include <climits>
 #include <cstdint>
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
-#include <stack>
+#include <algorithm>
+
+/* -===============
+     Internals
+   ================- */
+
+// Direct threading through computed gotos is a GNU extension, so the portable switch loop is
+// used everywhere else (or when LLAMA_NO_COMPUTED_GOTO is defined)
+#if defined(__GNUC__) && !defined(LLAMA_NO_COMPUTED_GOTO)
+    #define LLAMA_COMPUTED_GOTO
+#endif
+
+#ifdef LLAMA_TRACE
+    #define VM_TRACE() printf("executing op %.2x (at %zu)\n", (int)(pc->opcode), (size_t)(pc - code))
+#else
+    #define VM_TRACE()
+#endif
+
+#ifdef LLAMA_DEBUG
+    #define VM_NEED(__n) {\
+                if (sp - vm->stack < (ptrdiff_t)(__n)) {\
+                    PANIC(InvalidStack, "invalid stack access");\
+                    VM_FAIL();\
+                }\
+            }
+#else
+    #define VM_NEED(__n)
+#endif
+
+#ifdef LLAMA_COMPUTED_GOTO
+    #define VM_CASE(__name) L_ ## __name:
+    #define VM_DISPATCH()   { VM_TRACE(); goto * pc->handler; }
+#else
+    #define VM_CASE(__name) case GET_OP(__name):
+    #define VM_DISPATCH()   continue
+#endif
+
+#define VM_ARG(__n) (pc->args[(__n)])
+#define VM_NEXT()   { ++pc; VM_DISPATCH(); }
+#define VM_JUMP()   { pc = code + pc->target; VM_DISPATCH(); }
+#define VM_PUSH(__v) {\
+            if (sp >= stack_end) {\
+                RUNTIMEERROR(StackOverflow, "stack overflow (more than %zu values)", vm->config.stack_size);\
+                VM_FAIL();\
+            }\
+            * sp++ = (__v);\
+        }
+#define VM_POP()     { * --sp = Value(); }
+
+// Int operands skip the generic metafunctions, ints own nothing so the popped slot needs no reset.
+// Arithmetic wraps through uint32_t, like Value and the folder do
+#define VM_FAST_INT(__expr) {\
+            if (sp[-2].get_type() == Type::Int && sp[-1].get_type() == Type::Int) {\
+                int a = sp[-2].get_int();\
+                int b = sp[-1].get_int();\
+                sp[-2] = Value(__expr);\
+                --sp;\
+                VM_NEXT();\
+            }\
+        }
+#define VM_SYNC()    { vm->sp = sp; vm->fp = fp; }
+#define VM_BARRIER(__v) vm->heap->barrier(__v)
+#define VM_FAIL()    { VM_SYNC(); return Failure; }
 
 /* -===================
      VMRunner class
@@ -29,511 +93,630 @@ llama::VMRunner::VMRunner(VM * m_vm) {
 llama::VMRunner::~VMRunner() {}
 
 /* -=- Bytecode execution -=- */
+#ifdef LLAMA_COMPUTED_GOTO
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
 llama::Status llama::VMRunner::exec(size_t argc, bool pop) {
-    Status s = Ok;
+    CallFrame * entry_fp = vm->fp;
+    Value     * entry_sp = vm->sp - std::min((size_t)(vm->sp - vm->stack), argc + 1);
+
+    Status s = run(argc, pop);
+    if (s == Failure) {
+        // Unwinds every frame of the failed call, the function and its arguments included
+        while (vm->sp > entry_sp) vm->pop();
+        vm->fp = entry_fp;
+    }
 
+    return s;
+}
+
+llama::Status llama::VMRunner::run(size_t argc, bool pop) {
     auto * log = vm->log;
 
-    auto & fn_val = vm->stack.back();
-    if (fn_val.type != Type::Function) {
-        RUNTIMEERROR("attempt to call a %s value", fn_val.type_str());
-        return Failure;
-    }
+    // Everything touched by the hot loop lives in locals, the VM is only synced when needed
+    // TODO: make the stack and pretty much everything sandboxed
+    Value * sp        = vm->sp;
+    Value * stack_end = vm->stack + vm->config.stack_size;
+
+    // Script calls push frames here instead of recursing, so only host calls nest runners
+    CallFrame * entry      = vm->fp;
+    CallFrame * fp         = entry;
+    CallFrame * frames_end = vm->frames + vm->config.call_depth;
+
+    FunctionPool  * funcs = vm->module->get_functions();
+    FunctionEntry * func  = nullptr;
+    DecodedInst   * code  = nullptr;
+    DecodedInst   * pc    = nullptr;
+    Value         * base  = nullptr;
+    Value           result;
+
+    // Globals declared since the last call get their slots (the table may move when it grows)
+    Value *& globals = vm->globals;
+    if (!vm->reserve_globals(vm->module->get_globals()->size())) return Failure;
+
+    // Constant indexes were validated by the decoder, so they are never bounds checked here
+    ConstantEntry * consts = vm->module->get_constants()->entries.data();
+
+#ifdef LLAMA_COMPUTED_GOTO
+    // One row per 16 opcodes, holes go to L_UNKNOWN. A constant initializer, so runners on
+    // different threads never race on filling it
+    #define VM_LABEL(__name) &&L_ ## __name
+    #define VM_NONE          &&L_UNKNOWN
+    static void * const dispatch[] = {
+        /* 0x00 */ VM_LABEL(NOP),           VM_LABEL(JP),             VM_LABEL(JZ),             VM_LABEL(JNZ),
+                   VM_NONE,                 VM_LABEL(BLOCK),          VM_LABEL(IF),             VM_LABEL(ELSE),
+                   VM_LABEL(LOOP),          VM_LABEL(REPEAT),         VM_LABEL(BREAK),          VM_NONE,
+                   VM_NONE,                 VM_NONE,                  VM_NONE,                  VM_LABEL(END),
+        /* 0x10 */ VM_LABEL(PUSHNULL),      VM_LABEL(PUSHTRUE),       VM_LABEL(PUSHFALSE),      VM_LABEL(PUSHINT),
+                   VM_LABEL(PUSHFLOAT),     VM_LABEL(PUSHSTRING),     VM_LABEL(PUSHLIST),       VM_LABEL(PUSHOBJECT),
+                   VM_LABEL(PUSHDYN),       VM_NONE,                  VM_NONE,                  VM_NONE,
+                   VM_NONE,                 VM_NONE,                  VM_LABEL(PUSHFUNC),       VM_NONE,
+        /* 0x20 */ VM_LABEL(SETGLOBAL),     VM_LABEL(GETGLOBAL),      VM_LABEL(SETPROPERTY),    VM_LABEL(GETPROPERTY),
+                   VM_LABEL(SETINDEX),      VM_LABEL(GETINDEX),       VM_LABEL(NEWGLOBAL),      VM_LABEL(NEWLOCAL),
+                   VM_LABEL(GETLOCAL),      VM_LABEL(SETLOCAL),       VM_LABEL(GETGLOBAL_SLOT), VM_LABEL(SETGLOBAL_SLOT),
+                   VM_NONE,                 VM_NONE,                  VM_LABEL(POP),            VM_LABEL(POPN),
+        /* 0x30 */ VM_LABEL(ADD),           VM_LABEL(SUB),            VM_LABEL(MUL),            VM_LABEL(DIV),
+                   VM_LABEL(MOD),           VM_LABEL(POW),            VM_LABEL(NEGATE),         VM_LABEL(PROMOTE),
+                   VM_LABEL(BITNOT),        VM_LABEL(BITAND),         VM_LABEL(BITOR),          VM_LABEL(BITXOR),
+                   VM_LABEL(BITSHL),        VM_LABEL(BITSHR),         VM_LABEL(BITROL),         VM_LABEL(BITROR),
+        /* 0x40 */ VM_LABEL(NOT),           VM_LABEL(AND),            VM_LABEL(OR),             VM_LABEL(EQ),
+                   VM_LABEL(LT),            VM_LABEL(LE),             VM_LABEL(GT),             VM_LABEL(GE),
+                   VM_LABEL(NE),            VM_NONE,                  VM_NONE,                  VM_NONE,
+                   VM_NONE,                 VM_NONE,                  VM_NONE,                  VM_NONE,
+        /* 0x50 */ VM_LABEL(SIZEOF),        VM_LABEL(LENOF),          VM_LABEL(TYPEOF),         VM_LABEL(INSTANCEOF),
+                   VM_LABEL(THIS),          VM_LABEL(AS),             VM_NONE,                  VM_NONE,
+                   VM_NONE,                 VM_NONE,                  VM_NONE,                  VM_NONE,
+                   VM_NONE,                 VM_NONE,                  VM_NONE,                  VM_NONE,
+        /* 0x60 */ VM_LABEL(CALL),          VM_LABEL(CALLV),          VM_NONE,                  VM_NONE,
+                   VM_NONE,                 VM_LABEL(RETURN),         VM_LABEL(RETURNV),        VM_NONE,
+                   VM_NONE,                 VM_NONE,                  VM_NONE,                  VM_NONE,
+                   VM_NONE,                 VM_NONE,                  VM_NONE,                  VM_NONE,
+        /* 0x70 */ VM_LABEL(REF),           VM_LABEL(REFGLOBAL),      VM_LABEL(REFPROPERTY),    VM_LABEL(REFINDEX),
+                   VM_NONE,                 VM_NONE,                  VM_NONE,                  VM_NONE,
+                   VM_LABEL(REFSET),        VM_NONE,                  VM_NONE,                  VM_NONE,
+                   VM_NONE,                 VM_NONE,                  VM_NONE,                  VM_NONE,
+        /* 0x80 */ VM_LABEL(BREAKPOINT),    VM_LABEL(TYPECHECK),
+    };
+    #undef VM_NONE
+    #undef VM_LABEL
 
-    auto * func = vm->module->get_functions()->at(fn_val.data.__idx);
-    if (func == nullptr) {
-        RUNTIMEERROR("the function index %zu do not exist", fn_val.data.__idx);
-        return Failure;
-    }
+    const size_t dispatch_size = sizeof(dispatch) / sizeof(dispatch[0]);
+#endif
 
-    // TODO: make the stack and pretty much everything sandboxed
-    auto & stack = vm->stack;
-    if (pop) stack.pop_back();
+    // Calls land here with the function right below its (argc) arguments
+    enter: {
+        VM_NEED(argc + 1);
 
-    auto * consts = vm->module->get_constants();
-    
-    size_t pc    = 0;
-    size_t insts = 0;
-    bool   ret   = false;
+        Value & fn_val = sp[-(ptrdiff_t)(argc + 1)];
+        if (fn_val.get_type() != Type::Function) {
+            RUNTIMEERROR(NotCallable, "attempt to call a %s value", fn_val.type_str());
+            VM_FAIL();
+        }
 
-    std::stack<std::pair<size_t, size_t>> repeats;
+        FunctionEntry * callee = funcs->at(fn_val.get_idx());
+        if (callee == nullptr) {
+            RUNTIMEERROR(NotCallable, "the function index %zu do not exist", fn_val.get_idx());
+            VM_FAIL();
+        }
 
-    auto get_arg = [&](size_t n) -> int32_t {
-        return unpack<int32_t>(func->get_data(), pc + 1 + sizeof(int32_t) * n);
-    };
+        // Functions built outside of VM::read() are decoded on their first call
+        if (callee->get_code().empty() && !callee->decode(vm->module)) {
+            RUNTIMEERROR(MalformedBytecode, "malformed bytecode in function %zu", fn_val.get_idx());
+            VM_FAIL();
+        }
 
-    auto get_size = [&](unsigned char op) {
-        return sizeof(int32_t) * InstData(op).get_info().size + 1;
-    };
+#ifdef LLAMA_COMPUTED_GOTO
+        // Threads the function once, every instruction then jumps straight into its handler
+        if (callee->get_code().front().handler == nullptr) {
+            for (auto & inst : callee->get_code()) {
+                inst.handler = inst.opcode < dispatch_size ? dispatch[inst.opcode] : &&L_UNKNOWN;
+            }
+        }
+#endif
 
-    auto new_global = [&](size_t idx) {
-        auto * c = consts->at(idx);
-        if (c == nullptr) return Failure;
+        if (fp >= frames_end) {
+            RUNTIMEERROR(StackOverflow, "call stack overflow (more than %zu frames)", vm->config.call_depth);
+            VM_FAIL();
+        }
 
-        vm->globals[unpack<char[]>(c->get_data())] = Value();
+        // The frame starts at the first argument, extra arguments are dropped and the missing
+        // ones (along with every other local) start as null
+        base = sp - argc;
+        while (argc > callee->get_argc()) {
+            VM_POP();
+            --argc;
+        }
 
-        return Ok;
-    };
+        size_t locals = std::max(callee->get_argc(), callee->get_locals());
+        while ((size_t)(sp - base) < locals) VM_PUSH(Value());
 
-    auto do_inst = [&]() -> Status {
-        ++insts;
+        func = callee;
+        code = func->get_code().data();
 
-        unsigned char op = func->get_data()[pc];
-        printf("executing op %.2x (at %zu)\n", (int)op, (size_t)pc);
-        
-        if ((InstData(op).get_info().flags & GET_FLAG(STACKARG)) && stack.size() == 0) {
-            PANIC("invalid stack access");
-            return Failure;
+        fp->func   = func;
+        fp->code   = code;
+        fp->ret    = pc;
+        fp->base   = base;
+        fp->locals = locals;
+        ++fp;
+
+        pc = code;
+    }
+
+#ifdef LLAMA_COMPUTED_GOTO
+    VM_DISPATCH();
+#else
+    for (;;) {
+    VM_TRACE();
+    switch (pc->opcode) {
+#endif
+    VM_CASE(NOP) VM_NEXT();
+    VM_CASE(JP)  VM_JUMP();
+    VM_CASE(JZ) {
+        VM_NEED(1);
+        if (!(sp[-1].get_bool())) VM_JUMP();
+        VM_NEXT();
+    }
+    VM_CASE(JNZ) {
+        VM_NEED(1);
+        if (sp[-1].get_bool()) VM_JUMP();
+        VM_NEXT();
+    }
+    VM_CASE(BLOCK) VM_NEXT();
+    VM_CASE(IF) {
+        VM_NEED(1);
+        if (sp[-1].get_type() != Type::Bool) {
+            RUNTIMEERROR(TypeMismatch, "expected a bool as condition, got %s instead", sp[-1].type_str());
+            VM_FAIL();
         }
 
-        switch (op) {
-            case GET_OP(NOP): break;
-            case GET_OP(JP): {
-                pc += get_arg(0);
-                break;
-            }
-            case GET_OP(JZ): {
-                if (!(stack.back().data.__bool)) pc += get_arg(0);
-                break;
-            }
-            case GET_OP(JNZ): {
-                if (stack.size() > 0 && stack.back().data.__bool) pc += get_arg(0);
-                break;
-            }
-            case GET_OP(BLOCK): {
-                break;
-            }
-            case GET_OP(IF): {
-                if (stack.back().data.__bool) {
-                    size_t i = get_arg(0);
-                    while (i-- > 0) {
-                        pc += get_size(func->get_data()[pc]);
-                    }
-                }
-                break;
-            }
-            case GET_OP(ELSE): {
-                // TODO: brainstorm this one because I'm stupid
-                break;
-            }
-            case GET_OP(LOOP): {
-                size_t i = get_arg(0);
-                while (i-- > 0) {
-                    pc += get_size(func->get_data()[pc]);
-                }
-                break;
-            }
-            case GET_OP(REPEAT): {
-                break;
-            }
-            case GET_OP(BREAK): {
-                break;
-            }
-            case GET_OP(END): {
-                
-                break;
-            }
-            case GET_OP(PUSHNULL): {
-                stack.push_back(Value());
-                break;
-            }
-            case GET_OP(PUSHTRUE): {
-                stack.push_back(Value(true));
-                break;
-            }
-            case GET_OP(PUSHFALSE): {
-                stack.push_back(Value(false));
-                break;
-            }
-            case GET_OP(PUSHINT): {
-                size_t idx = get_arg(0);
-
-                auto * c = consts->at(idx);
-                if (c == nullptr) {
-                    PANIC("constant pool index %zu does not exist", idx);
-                    return Failure;
-                }
-                if (c->get_type() != ConstantEntry::Type::Int) {
-                    PANIC("constant index %zu is not an integer", idx);
-                    return Failure;
-                }
-
-                int val = unpack<int32_t>(c->get_data());
-                stack.push_back(Value(val));
-                break;
-            }
-            case GET_OP(PUSHFLOAT): {
-                size_t idx = get_arg(0);
-
-                auto * c = consts->at(idx);
-                if (c == nullptr) {
-                    PANIC("constant pool index %zu does not exist", idx);
-                    return Failure;
-                }
-                if (c->get_type() != ConstantEntry::Type::Float) {
-                    PANIC("constant index %zu is not a float", idx);
-                    return Failure;
-                }
-
-                stack.push_back(Value(unpack<double>(c->get_data())));
-                break;
-            }
-            case GET_OP(PUSHSTRING): {
-                break;
-            }
-            case GET_OP(PUSHLIST): {
-                break;
-            }
-            case GET_OP(PUSHOBJECT): {
-                break;
-            }
-            case GET_OP(PUSHDYN): {
-                break;
-            }
-            case GET_OP(PUSHFUNC): {
-                break;
-            }
-            case GET_OP(SETGLOBAL): {
-                // TODO: implement this crap
-                break;
-            }
-            case GET_OP(GETGLOBAL): {
-                size_t idx = get_arg(0);
-                auto * c   = consts->at(idx);
-                if (c == nullptr) {
-                    PANIC("constant pool index %zu does not exist", idx);
-                    return Failure;
-                }
-                
-                std::string name = unpack<char[]>(c->get_data());
-                
-                auto v = vm->globals[name];
-                if (v.type == Type::Null) {
-                    RUNTIMEERROR("the value \"%s\" was not declared in this scope", name.c_str());
-                    return Failure;
-                }
-
-                stack.push_back(v);
-                break;
-            }
-            case GET_OP(SETPROPERTY): {
-                // TODO: implement this crap
-                break;
-            }
-            case GET_OP(GETPROPERTY): {
-                // TODO: implement this crap
-                stack.push_back(Value());
-                break;
-            }
-            case GET_OP(SETINDEX): {
-                // TODO: implement this crap
-                break;
-            }
-            case GET_OP(GETINDEX): {
-                // TODO: implement this crap
-                stack.push_back(Value());
-                break;
-            }
-            case GET_OP(NEWGLOBAL): {
-                s = new_global(get_arg(0));
-                if (s == Failure) {
-                    return Failure;
-                }
-                break;
-            }
-            case GET_OP(NEWLOCAL): {
-                // TODO: implement this crap
-                break;
-            }
-            case GET_OP(POP): {
-                stack.pop_back();
-                break;
-            }
-            case GET_OP(POPN): {
-                vm->popn(get_arg(0));
-                break;
-            }
-            case GET_OP(ADD): {
-                Value & a = stack[stack.size() - 2];
-                Value & b = stack[stack.size() - 1];
-
-                Value v = a._add(b);
-                if (v.type == Type::Null) {
-                    RUNTIMEERROR("cannot add a value of type %s to a value of type %s", a.type_str(), b.type_str());
-                    return Failure;
-                }
-                a = v;
-                stack.pop_back();
-                break;
-            }
-            case GET_OP(SUB): {
-                Value & a = stack[stack.size() - 2];
-                Value & b = stack[stack.size() - 1];
-
-                Value v = a._sub(b);
-                if (v.type == Type::Null) {
-                    RUNTIMEERROR("cannot subtract a value of type %s to a value of type %s", a.type_str(), b.type_str());
-                    return Failure;
-                }
-                a = v;
-                stack.pop_back();
-                break;
-            }
-            case GET_OP(MUL): {
-                Value & a = stack[stack.size() - 2];
-                Value & b = stack[stack.size() - 1];
-
-                Value v = a._mul(b);
-                if (v.type == Type::Null) {
-                    RUNTIMEERROR("cannot multiply a value of type %s by a value of type %s", a.type_str(), b.type_str());
-                    return Failure;
-                }
-                a = v;
-                stack.pop_back();
-                break;
-            }
-            case GET_OP(DIV): {
-                Value & a = stack[stack.size() - 2];
-                Value & b = stack[stack.size() - 1];
-
-                Value v = a._div(b);
-                if (v.type == Type::Null) {
-                    RUNTIMEERROR("cannot divide a value of type %s by a value of type %s", a.type_str(), b.type_str());
-                    return Failure;
-                }
-                a = v;
-                stack.pop_back();
-                break;
-            }
-            case GET_OP(MOD): {
-                Value & a = stack[stack.size() - 2];
-                Value & b = stack[stack.size() - 1];
-
-                Value v = a._mod(b);
-                if (v.type == Type::Null) {
-                    RUNTIMEERROR("cannot obtain the remainder of a value of type %s by a value of type %s", a.type_str(), b.type_str());
-                    return Failure;
-                }
-                a = v;
-                stack.pop_back();
-                break;
-            }
-            case GET_OP(POW): {
-                Value & a = stack[stack.size() - 2];
-                Value & b = stack[stack.size() - 1];
-
-                Value v = a._pow(b);
-                if (v.type == Type::Null) {
-                    RUNTIMEERROR("cannot power a value of type %s by a value of type %s", a.type_str(), b.type_str());
-                    return Failure;
-                }
-                a = v;
-                stack.pop_back();
-                break;
-            }
-            case GET_OP(NEGATE): {
-                Value & a = stack[stack.size() - 2];
+        bool cond = sp[-1].get_bool();
+        VM_POP();
+        if (!cond) VM_JUMP();
+        VM_NEXT();
+    }
+    VM_CASE(ELSE)   VM_JUMP();
+    VM_CASE(LOOP)   VM_NEXT();
+    VM_CASE(REPEAT) VM_JUMP();
+    VM_CASE(BREAK)  VM_JUMP();
+    VM_CASE(END)    VM_JUMP();
+    VM_CASE(PUSHNULL) {
+        VM_PUSH(Value());
+        VM_NEXT();
+    }
+    VM_CASE(PUSHTRUE) {
+        VM_PUSH(Value(true));
+        VM_NEXT();
+    }
+    VM_CASE(PUSHFALSE) {
+        VM_PUSH(Value(false));
+        VM_NEXT();
+    }
+    VM_CASE(PUSHINT) {
+        // The decoder already replaced the constant index by the integer itself
+        VM_PUSH(Value((int)(VM_ARG(0))));
+        VM_NEXT();
+    }
+    VM_CASE(PUSHFLOAT) {
+        VM_PUSH(Value(unpack<double>(consts[VM_ARG(0)].get_data())));
+        VM_NEXT();
+    }
+    VM_CASE(PUSHSTRING) {
+        const char * str = unpack<char[]>(consts[VM_ARG(0)].get_data());
+
+        // Allocating may collect, so the heap has to see the current stack
+        VM_SYNC();
+        HeapObject * obj = vm->heap->alloc(Type::String, str, strlen(str) + 1);
+        if (obj == nullptr) {
+            RUNTIMEERROR(OutOfMemory, "out of memory (%zu KiB in use)", vm->heap->get_used() / 1024);
+            VM_FAIL();
+        }
 
-                Value v = a._negate();
-                if (v.type == Type::Null) {
-                    RUNTIMEERROR("cannot negate value of type %s", a.type_str());
-                    return Failure;
-                }
+        VM_PUSH(Value(obj));
+        VM_NEXT();
+    }
+    VM_CASE(PUSHLIST)   VM_NEXT();
+    VM_CASE(PUSHOBJECT) VM_NEXT();
+    VM_CASE(PUSHDYN)    VM_NEXT();
+    VM_CASE(PUSHFUNC) {
+        VM_PUSH(Value((size_t)(VM_ARG(0)), Type::Function));
+        VM_NEXT();
+    }
+    VM_CASE(SETGLOBAL) {
+        // Slow path by name, the analyser emits SETGLOBAL_SLOT for plain variables
+        Symbol symbol = vm->module->get_constants()->symbol(VM_ARG(0));
+
+        Value * v = VM_ARG(1) < 0 ? sp + VM_ARG(1) : vm->stack + VM_ARG(1);
+        if (v < vm->stack || v >= sp) {
+            PANIC(InvalidStack, "invalid stack access");
+            VM_FAIL();
+        }
 
-                a = v;
-                break;
-            }
-            case GET_OP(PROMOTE): {
-                Value & a = stack[stack.size() - 2];
+        size_t slot = vm->module->get_globals()->get(symbol);
+        if (!vm->reserve_globals(slot + 1)) VM_FAIL();
 
-                Value v = a._promote();
-                if (v.type == Type::Null) {
-                    RUNTIMEERROR("cannot negate value of type %s", a.type_str());
-                    return Failure;
-                }
+        VM_BARRIER(* v);
+        globals[slot] = * v;
+        VM_NEXT();
+    }
+    VM_CASE(GETGLOBAL) {
+        // Slow path by name, the analyser emits GETGLOBAL_SLOT for plain variables
+        size_t slot = vm->module->get_globals()->find(vm->module->get_constants()->symbol(VM_ARG(0)));
+        if (slot == ERROR_IDX_BIN || slot >= vm->global_count || globals[slot].get_type() == Type::Null) {
+            RUNTIMEERROR(NotDeclared, "the value \"%s\" was not declared in this scope", unpack<char[]>(consts[VM_ARG(0)].get_data()));
+            VM_FAIL();
+        }
 
-                a = v;
-                break;
-            }
-            case GET_OP(BITNOT): {
-                break;
-            }
-            case GET_OP(BITAND): {
-                break;
-            }
-            case GET_OP(BITOR): {
-                break;
-            }
-            case GET_OP(BITXOR): {
-                break;
-            }
-            case GET_OP(BITSHL): {
-                break;
-            }
-            case GET_OP(BITSHR): {
-                break;
-            }
-            case GET_OP(BITROL): {
-                break;
-            }
-            case GET_OP(BITROR): {
-                break;
-            }
-            case GET_OP(NOT): {
-                Value & a = stack[stack.size() - 1];
-                if (a.type == Type::Bool) {
-                    a.data.__bool = !a.data.__bool;
-                } else {
-                    RUNTIMEERROR("cannot logical 'not' a %s value", a.type_str());
-                    return Failure;
-                }
-                break;
-            }
-            case GET_OP(AND): {
-                Value & a = stack[stack.size() - 2];
-                Value & b = stack[stack.size() - 1];
-                if (a.type == Type::Bool) {
-                    a.data.__bool = a.data.__bool && b.data.__bool;
-                } else {
-                    RUNTIMEERROR("cannot logical 'and' a %s value", a.type_str());
-                    return Failure;
-                }
-                stack.pop_back();
-                break;
-            }
-            case GET_OP(OR): {
-                Value & a = stack[stack.size() - 2];
-                Value & b = stack[stack.size() - 1];
-                if (a.type == Type::Bool) {
-                    a.data.__bool = a.data.__bool || b.data.__bool;
-                } else {
-                    RUNTIMEERROR("cannot logical 'or' a %s value", a.type_str());
-                    return Failure;
-                }
-                stack.pop_back();
-                break;
-            }
-            case GET_OP(EQ): {
-                Value & a = stack[stack.size() - 2];
-                a = a._eq(stack[stack.size() - 1]);
-                stack.pop_back();
-                break;
-            }
-            case GET_OP(LT): {
-                Value & a = stack[stack.size() - 2];
-                a = a._lt(stack[stack.size() - 1]);
-                stack.pop_back();
-                break;
-            }
-            case GET_OP(LE): {
-                Value & a = stack[stack.size() - 2];
-                a = a._le(stack[stack.size() - 1]);
-                stack.pop_back();
-                break;
-            }
-            case GET_OP(GT): {
-                Value & a = stack[stack.size() - 2];
-                a = a._gt(stack[stack.size() - 1]);
-                stack.pop_back();
-                break;
-            }
-            case GET_OP(GE): {
-                Value & a = stack[stack.size() - 2];
-                a = a._ge(stack[stack.size() - 1]);
-                stack.pop_back();
-                break;
-            }
-            case GET_OP(NE): {
-                Value & a = stack[stack.size() - 2];
-                a = a._ne(stack[stack.size() - 1]);
-                stack.pop_back();
-                break;
-            }
-            case GET_OP(SIZEOF): {
-                break;
-            }
-            case GET_OP(LENOF): {
-                break;
-            }
-            case GET_OP(TYPEOF): {
-                break;
-            }
-            case GET_OP(INSTANCEOF): {
-                break;
-            }
-            case GET_OP(THIS): {
-                break;
-            }
-            case GET_OP(AS): {
-                size_t idx = get_arg(0);
-
-                auto * c = consts->at(idx);
-                if (c == nullptr) 
-                    PANIC("constant pool index %zu does not exist", idx);
-
-                const char * type_name = unpack<char[]>(c->get_data());
-
-                Value & value = stack.back();
-                if (std::string(value.type_str()) == type_name) break;
-
-                Value conv = value.convert(type_name);
-                if (conv.type != Type::Null) {
-                    stack.pop_back();
-                    stack.push_back(conv);
-                } else {
-                    RUNTIMEERROR("the type %s is not convertible to the type %s", value.type_str(), type_name);
-                    return Failure;
-                }
-                break;
-            }
-            case GET_OP(CALL): {
-                Status s = exec(get_arg(0), true);
-                if (s == Failure) return Failure;
-                break;
-            }
-            case GET_OP(CALLV): {
-                // TODO: maybe remove this opcode
-                break;
-            }
-            case GET_OP(RETURN): {
-                ret = true;
-                break;
-            }
-            case GET_OP(RETURNV): {
-                ret = true;
-                break;
-            }
-            case GET_OP(BREAKPOINT): {
-                INFO("breakpoint called at %.8x", (uint32_t)(pc));
-                break;
-            }
-            case GET_OP(REF): {
-                break;
-            }
-            case GET_OP(REFGLOBAL): {
-                break;
-            }
-            case GET_OP(REFPROPERTY): {
-                break;
+        VM_PUSH(globals[slot]);
+        VM_NEXT();
+    }
+    VM_CASE(SETPROPERTY) {
+        // TODO: implement this crap
+        VM_NEXT();
+    }
+    VM_CASE(GETPROPERTY) {
+        // TODO: implement this crap
+        VM_PUSH(Value());
+        VM_NEXT();
+    }
+    VM_CASE(SETINDEX) {
+        // TODO: implement this crap
+        VM_NEXT();
+    }
+    VM_CASE(GETINDEX) {
+        // TODO: implement this crap
+        VM_PUSH(Value());
+        VM_NEXT();
+    }
+    VM_CASE(NEWGLOBAL) {
+        globals[VM_ARG(0)] = Value();
+        VM_NEXT();
+    }
+    VM_CASE(NEWLOCAL) {
+        base[VM_ARG(0)] = Value();
+        VM_NEXT();
+    }
+    VM_CASE(GETLOCAL) {
+        VM_PUSH(base[VM_ARG(0)]);
+        VM_NEXT();
+    }
+    VM_CASE(SETLOCAL) {
+        VM_NEED(1);
+        base[VM_ARG(0)] = sp[-1];
+        VM_NEXT();
+    }
+    VM_CASE(GETGLOBAL_SLOT) {
+        Value & v = globals[VM_ARG(0)];
+        if (v.get_type() == Type::Null) {
+            RUNTIMEERROR(NotDeclared, "the value \"%s\" was not declared in this scope", 
+                         vm->module->get_globals()->name(VM_ARG(0)).c_str());
+            VM_FAIL();
+        }
+
+        VM_PUSH(v);
+        VM_NEXT();
+    }
+    VM_CASE(SETGLOBAL_SLOT) {
+        VM_NEED(1);
+        VM_BARRIER(sp[-1]);
+        globals[VM_ARG(0)] = sp[-1];
+        VM_NEXT();
+    }
+    VM_CASE(POP) {
+        VM_NEED(1);
+        VM_POP();
+        VM_NEXT();
+    }
+    VM_CASE(POPN) {
+        int n = VM_ARG(0);
+        VM_NEED(n);
+        while (n-- > 0) VM_POP();
+        VM_NEXT();
+    }
+    VM_CASE(ADD) {
+        VM_NEED(2);
+        VM_FAST_INT((int)((uint32_t)(a) + (uint32_t)(b)));
+        Value & a = sp[-2];
+        Value & b = sp[-1];
+
+        Value v = a._add(b);
+        if (v.get_type() == Type::Null) {
+            RUNTIMEERROR(TypeMismatch, "cannot add a value of type %s to a value of type %s", a.type_str(), b.type_str());
+            VM_FAIL();
+        }
+        a = v;
+        VM_POP();
+        VM_NEXT();
+    }
+    VM_CASE(SUB) {
+        VM_NEED(2);
+        VM_FAST_INT((int)((uint32_t)(a) - (uint32_t)(b)));
+        Value & a = sp[-2];
+        Value & b = sp[-1];
+
+        Value v = a._sub(b);
+        if (v.get_type() == Type::Null) {
+            RUNTIMEERROR(TypeMismatch, "cannot subtract a value of type %s to a value of type %s", a.type_str(), b.type_str());
+            VM_FAIL();
+        }
+        a = v;
+        VM_POP();
+        VM_NEXT();
+    }
+    VM_CASE(MUL) {
+        VM_NEED(2);
+        VM_FAST_INT((int)((uint32_t)(a) * (uint32_t)(b)));
+        Value & a = sp[-2];
+        Value & b = sp[-1];
+
+        Value v = a._mul(b);
+        if (v.get_type() == Type::Null) {
+            RUNTIMEERROR(TypeMismatch, "cannot multiply a value of type %s by a value of type %s", a.type_str(), b.type_str());
+            VM_FAIL();
+        }
+        a = v;
+        VM_POP();
+        VM_NEXT();
+    }
+    VM_CASE(DIV) {
+        VM_NEED(2);
+        Value & a = sp[-2];
+        Value & b = sp[-1];
+
+        // Both would trap on the machine instead of raising an error
+        if (a.get_type() == Type::Int && b.get_type() == Type::Int) {
+            if (b.get_int() == 0) {
+                RUNTIMEERROR(DivisionByZero, "cannot divide an int by zero");
+                VM_FAIL();
             }
-            case GET_OP(REFINDEX): {
-                break;
+            if (a.get_int() == INT_MIN && b.get_int() == -1) {
+                RUNTIMEERROR(IntegerOverflow, "cannot divide %d by -1 without overflowing", INT_MIN);
+                VM_FAIL();
             }
-            case GET_OP(REFSET): {
-                break;
+        }
+
+        Value v = a._div(b);
+        if (v.get_type() == Type::Null) {
+            RUNTIMEERROR(TypeMismatch, "cannot divide a value of type %s by a value of type %s", a.type_str(), b.type_str());
+            VM_FAIL();
+        }
+        a = v;
+        VM_POP();
+        VM_NEXT();
+    }
+    VM_CASE(MOD) {
+        VM_NEED(2);
+        Value & a = sp[-2];
+        Value & b = sp[-1];
+
+        // Both would trap on the machine instead of raising an error
+        if (a.get_type() == Type::Int && b.get_type() == Type::Int) {
+            if (b.get_int() == 0) {
+                RUNTIMEERROR(DivisionByZero, "cannot obtain the remainder of an int by zero");
+                VM_FAIL();
             }
-            case GET_OP(TYPECHECK): {
-                break;
+            if (a.get_int() == INT_MIN && b.get_int() == -1) {
+                RUNTIMEERROR(IntegerOverflow, "cannot obtain the remainder of %d by -1 without overflowing", INT_MIN);
+                VM_FAIL();
             }
         }
-        pc += get_size(op);
 
-        return Ok;
-    };
+        Value v = a._mod(b);
+        if (v.get_type() == Type::Null) {
+            RUNTIMEERROR(TypeMismatch, "cannot obtain the remainder of a value of type %s by a value of type %s", a.type_str(), b.type_str());
+            VM_FAIL();
+        }
+        a = v;
+        VM_POP();
+        VM_NEXT();
+    }
+    VM_CASE(POW) {
+        VM_NEED(2);
+        Value & a = sp[-2];
+        Value & b = sp[-1];
+
+        Value v = a._pow(b);
+        if (v.get_type() == Type::Null) {
+            RUNTIMEERROR(TypeMismatch, "cannot power a value of type %s by a value of type %s", a.type_str(), b.type_str());
+            VM_FAIL();
+        }
+        a = v;
+        VM_POP();
+        VM_NEXT();
+    }
+    VM_CASE(NEGATE) {
+        VM_NEED(1);
+        Value & a = sp[-1];
+
+        Value v = a._negate();
+        if (v.get_type() == Type::Null) {
+            RUNTIMEERROR(TypeMismatch, "cannot negate value of type %s", a.type_str());
+            VM_FAIL();
+        }
 
-    while (pc < func->get_data().size() && !ret) {
-        do_inst();
+        a = v;
+        VM_NEXT();
     }
+    VM_CASE(PROMOTE) {
+        VM_NEED(1);
+        Value & a = sp[-1];
+
+        Value v = a._promote();
+        if (v.get_type() == Type::Null) {
+            RUNTIMEERROR(TypeMismatch, "cannot negate value of type %s", a.type_str());
+            VM_FAIL();
+        }
 
-    return s;
-}
\ No newline at end of file
+        a = v;
+        VM_NEXT();
+    }
+    VM_CASE(BITNOT) VM_NEXT();
+    VM_CASE(BITAND) VM_NEXT();
+    VM_CASE(BITOR)  VM_NEXT();
+    VM_CASE(BITXOR) VM_NEXT();
+    VM_CASE(BITSHL) VM_NEXT();
+    VM_CASE(BITSHR) VM_NEXT();
+    VM_CASE(BITROL) VM_NEXT();
+    VM_CASE(BITROR) VM_NEXT();
+    VM_CASE(NOT) {
+        VM_NEED(1);
+        Value & a = sp[-1];
+        if (a.get_type() != Type::Bool) {
+            RUNTIMEERROR(TypeMismatch, "cannot logical 'not' a %s value", a.type_str());
+            VM_FAIL();
+        }
+        a = Value(!a.get_bool());
+        VM_NEXT();
+    }
+    VM_CASE(AND) {
+        VM_NEED(2);
+        Value & a = sp[-2];
+        Value & b = sp[-1];
+        if (a.get_type() != Type::Bool) {
+            RUNTIMEERROR(TypeMismatch, "cannot logical 'and' a %s value", a.type_str());
+            VM_FAIL();
+        }
+        a = Value(a.get_bool() && b.get_bool());
+        VM_POP();
+        VM_NEXT();
+    }
+    VM_CASE(OR) {
+        VM_NEED(2);
+        Value & a = sp[-2];
+        Value & b = sp[-1];
+        if (a.get_type() != Type::Bool) {
+            RUNTIMEERROR(TypeMismatch, "cannot logical 'or' a %s value", a.type_str());
+            VM_FAIL();
+        }
+        a = Value(a.get_bool() || b.get_bool());
+        VM_POP();
+        VM_NEXT();
+    }
+    VM_CASE(EQ) {
+        VM_NEED(2);
+        VM_FAST_INT(a == b);
+        sp[-2] = sp[-2]._eq(sp[-1]);
+        VM_POP();
+        VM_NEXT();
+    }
+    VM_CASE(LT) {
+        VM_NEED(2);
+        VM_FAST_INT(a < b);
+        sp[-2] = sp[-2]._lt(sp[-1]);
+        VM_POP();
+        VM_NEXT();
+    }
+    VM_CASE(LE) {
+        VM_NEED(2);
+        VM_FAST_INT(a <= b);
+        sp[-2] = sp[-2]._le(sp[-1]);
+        VM_POP();
+        VM_NEXT();
+    }
+    VM_CASE(GT) {
+        VM_NEED(2);
+        VM_FAST_INT(a > b);
+        sp[-2] = sp[-2]._gt(sp[-1]);
+        VM_POP();
+        VM_NEXT();
+    }
+    VM_CASE(GE) {
+        VM_NEED(2);
+        VM_FAST_INT(a >= b);
+        sp[-2] = sp[-2]._ge(sp[-1]);
+        VM_POP();
+        VM_NEXT();
+    }
+    VM_CASE(NE) {
+        VM_NEED(2);
+        VM_FAST_INT(a != b);
+        sp[-2] = sp[-2]._ne(sp[-1]);
+        VM_POP();
+        VM_NEXT();
+    }
+    VM_CASE(SIZEOF)     VM_NEXT();
+    VM_CASE(LENOF)      VM_NEXT();
+    VM_CASE(TYPEOF)     VM_NEXT();
+    VM_CASE(INSTANCEOF) VM_NEXT();
+    VM_CASE(THIS)       VM_NEXT();
+    VM_CASE(AS) {
+        VM_NEED(1);
+        const char * type_name = unpack<char[]>(consts[VM_ARG(0)].get_data());
+
+        // Compared in place, the target name is read straight from the constant pool
+        Value & value = sp[-1];
+        if (strcmp(value.type_str(), type_name) != 0) {
+            Value conv = value.convert(type_name);
+            if (conv.get_type() == Type::Null) {
+                RUNTIMEERROR(TypeMismatch, "the type %s is not convertible to the type %s", value.type_str(), type_name);
+                VM_FAIL();
+            }
+            value = conv;
+        }
+        VM_NEXT();
+    }
+    VM_CASE(CALL) {
+        argc = VM_ARG(0);
+        ++pc; // Where the caller resumes
+        goto enter;
+    }
+    VM_CASE(CALLV) {
+        // TODO: maybe remove this opcode
+        VM_NEXT();
+    }
+    VM_CASE(RETURN) {
+        VM_NEED(1);
+        result = sp[-1];
+        goto leave;
+    }
+    VM_CASE(RETURNV) {
+        result = Value();
+        goto leave;
+    }
+    leave: {
+        // The whole frame (function included) is replaced by the result
+        while (sp >= base) VM_POP();
+        --fp;
+
+        if (fp == entry) {
+            if (!pop) * sp++ = result;
+            VM_SYNC();
+            return Ok;
+        }
+
+        * sp++ = result;
+        pc     = fp->ret;
+        func   = fp[-1].func;
+        code   = fp[-1].code;
+        base   = fp[-1].base;
+        VM_DISPATCH();
+    }
+    VM_CASE(BREAKPOINT) {
+        INFO("breakpoint called at %.8x", (uint32_t)(pc - code));
+        VM_NEXT();
+    }
+    VM_CASE(REF)         VM_NEXT();
+    VM_CASE(REFGLOBAL)   VM_NEXT();
+    VM_CASE(REFPROPERTY) VM_NEXT();
+    VM_CASE(REFINDEX)    VM_NEXT();
+    VM_CASE(REFSET)      VM_NEXT();
+    VM_CASE(TYPECHECK)   VM_NEXT();
+#ifdef LLAMA_COMPUTED_GOTO
+    L_UNKNOWN: {
+#else
+    default: {
+#endif
+        PANIC(MalformedBytecode, "unknown opcode %.2x (at %zu)", (int)(pc->opcode), (size_t)(pc - code));
+        VM_FAIL();
+    }
+#ifndef LLAMA_COMPUTED_GOTO
+    }
+    }
+#endif
+}
+
+#ifdef LLAMA_COMPUTED_GOTO
+    #pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,152 @@
+/* -=- Includes -=- */
+#include <lexer.h>
+#include <module.h>
+#include <error.h>
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Lexing a source with several threads must give exactly the tokens of a serial read. The source
+// is made of ordinary lines, with multi-line strings and comments (and single line ones hiding
+// quotes and comment markers) laid across every place where Lexer::split() aims a chunk boundary
+
+#define SOURCE_SIZE (3 * LLAMA_LEX_PARALLEL_MIN / 2)
+
+struct Tokens {
+    std::vector<llama::Token::Type> types;
+    std::vector<uint32_t>           starts;
+    std::vector<uint32_t>           lengths;
+    std::vector<llama::Token::Data> values;
+};
+
+static const size_t thread_counts[] = { 2, 3, 4, 8 };
+
+static const char * filler[] = {
+    "var name_%zu = 0x1f + 42 * (count - 7);\n",
+    "let ratio_%zu = 3.25 / (1.5 + x);\n",
+    "print(\"a // string, /* with */ comment markers %zu\");\n",
+    "// a comment with a \"quote and a 'quote %zu\n",
+    "/* a block comment %zu with a \" quote */ var c = 'c';\n",
+    "if a < b and not c { f(g(%zu), `raw`); }\n",
+};
+
+// Constructs laid across the boundaries, they all go over several lines
+static const char * straddlers[] = {
+    "var long_str = \"first line\nsecond line // not a comment\nthird /* nor this */ line\n"
+    "fourth line\nfifth line\";\n",
+    "/* a block comment\n   with a \"quote\n   and a // line comment\n   over five lines\n*/\n",
+    "var raw = `raw\nstring\nwith 'quotes\" inside\nand more\n`;\n",
+    "// a line comment with an opening \" quote\nvar after = \"the quote above didn't count\n\";\n",
+};
+
+static std::string make_source() {
+    // Where split() aims for each thread count, the construct starts a bit before so the first
+    // newline past the mark falls inside it
+    std::vector<size_t> marks;
+    for (size_t count : thread_counts) {
+        for (size_t k = 1; k < count; ++k) marks.push_back(SOURCE_SIZE / count * k);
+    }
+    std::sort(marks.begin(), marks.end());
+
+    std::string src;
+    size_t      mark = 0;
+    size_t      line = 0;
+    char        buf[256];
+
+    while (src.length() + 256 < SOURCE_SIZE) {
+        while (mark < marks.size() && marks[mark] < src.length()) ++mark;
+
+        if (mark < marks.size() && marks[mark] - src.length() < 64) {
+            src += straddlers[mark % (sizeof(straddlers) / sizeof(straddlers[0]))];
+            ++mark;
+        } else {
+            snprintf(buf, sizeof(buf), filler[line % (sizeof(filler) / sizeof(filler[0]))], line);
+            src += buf;
+        }
+        ++line;
+    }
+
+    // Padded to the exact size the marks were computed for
+    size_t rest = SOURCE_SIZE - src.length();
+    src += "//" + std::string(rest - 3, '-') + "\n";
+
+    return src;
+}
+
+static bool lex(const std::string & src, size_t threads, Tokens & out) {
+    llama::Logger log;
+    llama::Module mod;
+    llama::Lexer  lex;
+
+    lex.set_symbols(mod.get_symbols());
+    lex.parse(&log, src, threads);
+
+    for (size_t i = 0; lex.has(i); ++i) {
+        llama::Token token = lex.at(i);
+        out.types.push_back(token.type);
+        out.starts.push_back(token.start);
+        out.lengths.push_back(token.length);
+        out.values.push_back(token.data);
+        lex.release(i + 1);
+    }
+
+    return !log.has_error();
+}
+
+static bool same_value(llama::Token::Type type, const llama::Token::Data & a, const llama::Token::Data & b) {
+    switch (type) {
+        case llama::Token::Type::Label:   return a.symbol == b.symbol;
+        case llama::Token::Type::Integer: return a.integer == b.integer;
+        case llama::Token::Type::Decimal: return memcmp(&a.decimal, &b.decimal, sizeof(double)) == 0;
+        default:                          return true;
+    }
+}
+
+int main() {
+    std::string src = make_source();
+
+    Tokens serial;
+    if (!lex(src, 1, serial)) {
+        fprintf(stderr, "lexer_parallel: the source failed to lex\n");
+        return 1;
+    }
+
+    int failures = 0;
+    for (size_t count : thread_counts) {
+        Tokens parallel;
+        if (!lex(src, count, parallel)) {
+            fprintf(stderr, "lexer_parallel: the source failed to lex with %zu threads\n", count);
+            ++failures;
+            continue;
+        }
+
+        if (parallel.types.size() != serial.types.size()) {
+            fprintf(stderr, "lexer_parallel: %zu tokens with %zu threads, %zu with one\n",
+                    parallel.types.size(), count, serial.types.size());
+            ++failures;
+            continue;
+        }
+
+        for (size_t i = 0; i < serial.types.size(); ++i) {
+            if (parallel.types[i]   != serial.types[i]   ||
+                parallel.starts[i]  != serial.starts[i]  ||
+                parallel.lengths[i] != serial.lengths[i] ||
+                !same_value(serial.types[i], parallel.values[i], serial.values[i])) {
+                fprintf(stderr, "lexer_parallel: token %zu (at byte %u) differs with %zu threads\n",
+                        i, serial.starts[i], count);
+                ++failures;
+                break;
+            }
+        }
+    }
+
+    if (failures > 0) return 1;
+
+    printf("lexer_parallel: %zu tokens, identical with", serial.types.size());
+    for (size_t count : thread_counts) printf(" %zu", count);
+    printf(" threads\n");
+    return 0;
+}